@@ -0,0 +1,399 @@
+#include "archive.h"
+#include "file_utils.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define fseek64 _fseeki64
+#define ftell64 _ftelli64
+#else
+#define fseek64 fseeko
+#define ftell64 ftello
+#endif
+
+#define TAR_BLOCK 512
+#define ZIP_LOCAL_HEADER    0x04034b50
+#define ZIP_CENTRAL_HEADER  0x02014b50
+#define ZIP_END             0x06054b50
+#define ZIP64_END           0x06064b50
+#define ZIP64_END_LOCATOR   0x07064b50
+#define ZIP_MAX_COMMENT     0xFFFF
+
+static int has_suffix(const char *s, size_t len, const char *suffix)
+{
+    size_t n = strlen(suffix);
+    if (len < n)
+        return 0;
+    s += len - n;
+    while (*suffix)
+        if (tolower((unsigned char) *s++) != *suffix++)
+            return 0;
+    return 1;
+}
+
+static int has_archive_suffix(const char *s, size_t len)
+{
+    return has_suffix(s, len, ".tar") || has_suffix(s, len, ".zip");
+}
+
+int archive_has_extension(const char *filename)
+{
+    return has_archive_suffix(filename, strlen(filename));
+}
+
+void archive_init(struct archive *a)
+{
+    a->nb_members = 0;
+    a->members = NULL;
+}
+
+void archive_free(struct archive *a)
+{
+    int i;
+    for (i = 0; i < a->nb_members; i++)
+        free(a->members[i].name);
+    free(a->members);
+    archive_init(a);
+}
+
+/*
+name is taken over
+*/
+static int add_member(struct archive *a, char *name, int64_t offset, int64_t size)
+{
+    struct archive_member *m = realloc(a->members, (a->nb_members + 1) * sizeof(*m));
+    if (!m)
+    {
+        free(name);
+        return -1;
+    }
+    a->members = m;
+    m += a->nb_members++;
+    m->name = name;
+    m->offset = offset;
+    m->size = size;
+    return 0;
+}
+
+static char *strndup_(const char *s, size_t max)
+{
+    size_t len = 0;
+    while (len < max && s[len])
+        len++;
+    char *r = malloc(len + 1);
+    if (r)
+    {
+        memcpy(r, s, len);
+        r[len] = 0;
+    }
+    return r;
+}
+
+/* octal or base-256 (gnu, for large sizes) number of a tar header */
+static int64_t tar_number(const unsigned char *p, int len)
+{
+    int64_t v = 0;
+    int i;
+    if (p[0] & 0x80)
+    {
+        v = p[0] & 0x7F;
+        for (i = 1; i < len; i++)
+            v = v << 8 | p[i];
+        return v;
+    }
+    for (i = 0; i < len && (p[i] == ' ' || p[i] == 0); i++)
+        ;
+    for (; i < len && p[i] >= '0' && p[i] <= '7'; i++)
+        v = v * 8 + (p[i] - '0');
+    return v;
+}
+
+static int tar_checksum_ok(const unsigned char *h)
+{
+    int64_t sum = 0;
+    int i;
+    for (i = 0; i < TAR_BLOCK; i++)
+        sum += (i >= 148 && i < 156) ? ' ' : h[i];
+    return sum == tar_number(h + 148, 8);
+}
+
+/*
+return "path" of pax extended header records, NULL if there is none
+*/
+static char *pax_path(const char *rec, int64_t size)
+{
+    const char *end = rec + size;
+    while (rec < end)
+    {
+        char *p;
+        long len = strtol(rec, &p, 10);
+        if (len <= 0 || rec + len > end || *p != ' ')
+            break;
+        p++;
+        if (!strncmp(p, "path=", 5))
+            return strndup_(p + 5, rec + len - 1 - (p + 5)); // record ends with '\n'
+        rec += len;
+    }
+    return NULL;
+}
+
+static int read_tar(struct archive *a, FILE *fp)
+{
+    unsigned char h[TAR_BLOCK];
+    char *long_name = NULL; // from gnu 'L' or pax 'x' header of the next member
+    int64_t pos = 0;
+    int result = -1;
+
+    while (fread(h, TAR_BLOCK, 1, fp) == 1)
+    {
+        if (!h[0])
+        {
+            result = 0; // end of archive
+            break;
+        }
+        if (!tar_checksum_ok(h))
+            break;
+        int64_t size = tar_number(h + 124, 12);
+        int64_t data = pos + TAR_BLOCK;
+        char type = h[156];
+
+        if (type == 'L' || type == 'x')
+        {
+            char *buf = size < (1 << 20) ? malloc(size + 1) : NULL;
+            if (!buf || fread(buf, 1, size, fp) != (size_t) size)
+            {
+                free(buf);
+                break;
+            }
+            buf[size] = 0;
+            free(long_name);
+            long_name = type == 'L' ? strndup_(buf, size) : pax_path(buf, size);
+            free(buf);
+        }
+        else if (type == '0' || type == 0)
+        {
+            char *name = long_name;
+            long_name = NULL;
+            if (!name && !memcmp(h + 257, "ustar", 5) && h[345])
+            {
+                // prefix/name
+                char *prefix = strndup_((const char *) h + 345, 155);
+                char *base = strndup_((const char *) h, 100);
+                name = prefix && base ? malloc(strlen(prefix) + strlen(base) + 2) : NULL;
+                if (name)
+                    sprintf(name, "%s/%s", prefix, base);
+                free(prefix);
+                free(base);
+            }
+            else if (!name)
+                name = strndup_((const char *) h, 100);
+            if (!name || add_member(a, name, data, size))
+                break;
+        }
+        else
+        {
+            free(long_name);
+            long_name = NULL;
+        }
+
+        pos = data + (size + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+        if (fseek64(fp, pos, SEEK_SET))
+            break;
+    }
+    if (feof(fp))
+        result = 0; // some writers don't add the end blocks
+    free(long_name);
+    return result;
+}
+
+static uint32_t le16(const unsigned char *p) { return p[0] | p[1] << 8; }
+static uint32_t le32(const unsigned char *p) { return le16(p) | (uint32_t) le16(p + 2) << 16; }
+static uint64_t le64(const unsigned char *p) { return le32(p) | (uint64_t) le32(p + 4) << 32; }
+
+/*
+find the central directory from the end record. return -1 if not found
+*/
+static int zip_central_directory(FILE *fp, int64_t *cd_offset, int64_t *cd_entries)
+{
+    unsigned char buf[22 + ZIP_MAX_COMMENT];
+    if (fseek64(fp, 0, SEEK_END))
+        return -1;
+    int64_t file_size = ftell64(fp);
+    int64_t len = file_size < (int64_t) sizeof(buf) ? file_size : (int64_t) sizeof(buf);
+    if (len < 22 || fseek64(fp, file_size - len, SEEK_SET) || fread(buf, 1, len, fp) != (size_t) len)
+        return -1;
+
+    int64_t i;
+    for (i = len - 22; i >= 0; i--)
+        if (le32(buf + i) == ZIP_END)
+            break;
+    if (i < 0)
+        return -1;
+    *cd_entries = le16(buf + i + 10);
+    *cd_offset = le32(buf + i + 16);
+
+    // zip64 end record is found through the locator just before the end record
+    int64_t end_pos = file_size - len + i;
+    unsigned char loc[20], end64[56];
+    if ((*cd_offset == 0xFFFFFFFF || *cd_entries == 0xFFFF) && end_pos >= 20
+        && !fseek64(fp, end_pos - 20, SEEK_SET) && fread(loc, 20, 1, fp) == 1
+        && le32(loc) == ZIP64_END_LOCATOR
+        && !fseek64(fp, (int64_t) le64(loc + 8), SEEK_SET) && fread(end64, 56, 1, fp) == 1
+        && le32(end64) == ZIP64_END)
+    {
+        *cd_entries = (int64_t) le64(end64 + 32);
+        *cd_offset = (int64_t) le64(end64 + 48);
+    }
+    return 0;
+}
+
+static int read_zip(struct archive *a, FILE *fp)
+{
+    int64_t cd_offset, cd_entries, i;
+    if (zip_central_directory(fp, &cd_offset, &cd_entries) || fseek64(fp, cd_offset, SEEK_SET))
+        return -1;
+
+    for (i = 0; i < cd_entries; i++)
+    {
+        unsigned char h[46];
+        if (fread(h, 46, 1, fp) != 1 || le32(h) != ZIP_CENTRAL_HEADER)
+            return -1;
+        int flags = le16(h + 8), method = le16(h + 10);
+        int64_t comp_size = le32(h + 20), size = le32(h + 24);
+        int name_len = le16(h + 28), extra_len = le16(h + 30), comment_len = le16(h + 32);
+        int64_t local = le32(h + 42);
+
+        char *name = malloc(name_len + 1);
+        unsigned char *extra = malloc(extra_len + 1);
+        if (!name || !extra || fread(name, 1, name_len, fp) != (size_t) name_len
+            || fread(extra, 1, extra_len, fp) != (size_t) extra_len
+            || fseek64(fp, comment_len, SEEK_CUR))
+        {
+            free(name);
+            free(extra);
+            return -1;
+        }
+        name[name_len] = 0;
+
+        // zip64 extended information has the fields which are 0xFFFFFFFF, in this order
+        int j = 0;
+        while (j + 4 <= extra_len)
+        {
+            int id = le16(extra + j), len = le16(extra + j + 2);
+            const unsigned char *p = extra + j + 4, *end = p + len;
+            if (j + 4 + len > extra_len)
+                break;
+            if (id == 0x0001)
+            {
+                if (size == 0xFFFFFFFF && p + 8 <= end)
+                    size = (int64_t) le64(p), p += 8;
+                if (comp_size == 0xFFFFFFFF && p + 8 <= end)
+                    comp_size = (int64_t) le64(p), p += 8;
+                if (local == 0xFFFFFFFF && p + 8 <= end)
+                    local = (int64_t) le64(p);
+            }
+            j += 4 + len;
+        }
+        free(extra);
+
+        // only stored & not encrypted files can be read in place
+        if (method != 0 || (flags & 1) || comp_size != size || (name_len && name[name_len-1] == '/'))
+        {
+            free(name);
+            continue;
+        }
+        int64_t next = ftell64(fp);
+        unsigned char lh[30];
+        if (fseek64(fp, local, SEEK_SET) || fread(lh, 30, 1, fp) != 1 || le32(lh) != ZIP_LOCAL_HEADER
+            || add_member(a, name, local + 30 + le16(lh + 26) + le16(lh + 28), size)
+            || fseek64(fp, next, SEEK_SET))
+            return -1;
+    }
+    return 0;
+}
+
+/*
+list members of archive filename. return 0 if ok
+*/
+int archive_open(struct archive *a, const char *filename)
+{
+    unsigned char magic[4];
+    archive_init(a);
+    const tchar_t *tname = utf8_to_tchar(filename);
+    FILE *fp = _tfopen(tname, _T("rb"));
+    free_conv_result(tname);
+    if (!fp)
+        return -1;
+
+    int result = -1;
+    if (fread(magic, 4, 1, fp) == 1 && !fseek64(fp, 0, SEEK_SET))
+        result = le32(magic) == ZIP_LOCAL_HEADER || le32(magic) == ZIP_END ? read_zip(a, fp) : read_tar(a, fp);
+    fclose(fp);
+    if (result)
+        archive_free(a);
+    return result;
+}
+
+const struct archive_member *archive_find(const struct archive *a, const char *name)
+{
+    int i;
+    for (i = 0; i < a->nb_members; i++)
+        if (!strcmp(a->members[i].name, name))
+            return &a->members[i];
+    return NULL;
+}
+
+/*
+split bundle.tar#inner/clip.mp4 into the archive's filename (returned,
+caller needs to free it) & member. return NULL if path isn't in an archive
+*/
+char *archive_split_path(const char *path, const char **member)
+{
+    const char *sep;
+    const tchar_t *tpath = utf8_to_tchar(path);
+    int exists = is_reg(tpath);
+    free_conv_result(tpath);
+    if (exists)
+        return NULL; // a file with '#' in its name
+    for (sep = strchr(path, ARCHIVE_SEPARATOR); sep; sep = strchr(sep + 1, ARCHIVE_SEPARATOR))
+    {
+        if (!has_archive_suffix(path, sep - path))
+            continue;
+        char *archive = strndup_(path, sep - path);
+        const tchar_t *tname = utf8_to_tchar(archive);
+        int found = archive && is_reg(tname);
+        free_conv_result(tname);
+        if (found)
+        {
+            *member = sep + 1;
+            return archive;
+        }
+        free(archive);
+    }
+    return NULL;
+}
+
+/*
+name used for output files of a member: bundle.tar_inner_clip.mp4 in the
+directory of the archive. caller needs to free it. NULL if path isn't in an archive
+*/
+char *archive_output_name(const char *path)
+{
+    const char *member;
+    char *archive = archive_split_path(path, &member);
+    if (!archive)
+        return NULL;
+    char *name = malloc(strlen(archive) + 1 + strlen(member) + 1);
+    if (name)
+    {
+        char *p;
+        sprintf(name, "%s_%s", archive, member);
+        for (p = name + strlen(archive); *p; p++)
+            if (*p == '/' || *p == '\\')
+                *p = '_';
+    }
+    free(archive);
+    return name;
+}
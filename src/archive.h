@@ -0,0 +1,34 @@
+#ifndef ARCHIVE_H_
+#define ARCHIVE_H_
+
+#include <stdint.h>
+
+/*
+members of uncompressed .tar & .zip (stored) bundles. a member is read
+in place through its byte range, so it doesn't have to be extracted.
+a member is named like bundle.tar#inner/clip.mp4
+*/
+struct archive_member
+{
+    char *name;     // path inside the archive, '/' separated
+    int64_t offset; // of the member's data in the archive
+    int64_t size;
+};
+
+struct archive
+{
+    int nb_members;
+    struct archive_member *members; // only regular files which can be read in place
+};
+
+#define ARCHIVE_SEPARATOR '#'
+
+int archive_has_extension(const char *filename);
+void archive_init(struct archive *a);
+int archive_open(struct archive *a, const char *filename);
+const struct archive_member *archive_find(const struct archive *a, const char *name);
+void archive_free(struct archive *a);
+char *archive_split_path(const char *path, const char **member);
+char *archive_output_name(const char *path);
+
+#endif /* ARCHIVE_H_ */
@@ -0,0 +1,142 @@
+#include "decoder_pool.h"
+#include <string.h>
+#include <libavutil/crc.h>
+
+struct decoder_pool_entry
+{
+    AVCodecContext *ctx; // NULL = free
+    struct decoder_key key;
+    int64_t last_used;
+};
+
+struct sws_pool_entry
+{
+    struct SwsContext *ctx; // NULL = free
+    int src_w, src_h, dst_w, dst_h, flags;
+    enum AVPixelFormat src_fmt, dst_fmt;
+    int64_t last_used;
+};
+
+static struct decoder_pool_entry gb_decoder_pool[DECODER_POOL_SIZE];
+static int64_t gb_decoder_pool_clock = 0;
+static struct sws_pool_entry gb_sws_pool[SWS_POOL_SIZE];
+
+static void free_codec_context(AVCodecContext **ctx)
+{
+    avcodec_close(*ctx);
+    avcodec_free_context(ctx);
+}
+
+void decoder_key_from_params(struct decoder_key *k, const AVCodecParameters *par)
+{
+    memset(k, 0, sizeof(*k));
+    k->codec_id = par->codec_id;
+    k->codec_tag = par->codec_tag;
+    k->width = par->width;
+    k->height = par->height;
+    k->format = par->format;
+    k->bits_per_coded_sample = par->bits_per_coded_sample;
+    k->profile = par->profile;
+    k->level = par->level;
+    k->extradata_size = par->extradata_size;
+    if (par->extradata && par->extradata_size > 0)
+        k->extradata_crc = av_crc(av_crc_get_table(AV_CRC_32_IEEE), 0, par->extradata, par->extradata_size);
+}
+
+/*
+return a flushed open decoder for key k, NULL if there is none
+*/
+AVCodecContext *decoder_pool_get(const struct decoder_key *k)
+{
+    int i;
+    for (i = 0; i < DECODER_POOL_SIZE; i++)
+    {
+        struct decoder_pool_entry *e = &gb_decoder_pool[i];
+        if (e->ctx && !memcmp(&e->key, k, sizeof(*k)))
+        {
+            AVCodecContext *ctx = e->ctx;
+            e->ctx = NULL;
+            avcodec_flush_buffers(ctx);
+            return ctx;
+        }
+    }
+    return NULL;
+}
+
+/*
+keep open decoder ctx for the next file; the least recently used one is
+closed if the pool is full
+*/
+void decoder_pool_put(AVCodecContext *ctx, const struct decoder_key *k)
+{
+    struct decoder_pool_entry *victim = &gb_decoder_pool[0];
+    int i;
+    for (i = 0; i < DECODER_POOL_SIZE; i++)
+    {
+        struct decoder_pool_entry *e = &gb_decoder_pool[i];
+        if (!e->ctx)
+        {
+            victim = e;
+            break;
+        }
+        if (e->last_used < victim->last_used)
+            victim = e;
+    }
+    if (victim->ctx)
+        free_codec_context(&victim->ctx);
+    victim->ctx = ctx;
+    victim->key = *k;
+    victim->last_used = ++gb_decoder_pool_clock;
+}
+
+/*
+return scaler for the geometry; it's owned by the pool & reused as long as
+the parameters don't change. the least recently used one is freed if the
+pool is full, so a file can use up to SWS_POOL_SIZE scalers at once
+*/
+struct SwsContext *decoder_pool_get_sws(int src_w, int src_h, enum AVPixelFormat src_fmt,
+    int dst_w, int dst_h, enum AVPixelFormat dst_fmt, int flags)
+{
+    struct sws_pool_entry *victim = &gb_sws_pool[0];
+    int i;
+    for (i = 0; i < SWS_POOL_SIZE; i++)
+    {
+        struct sws_pool_entry *e = &gb_sws_pool[i];
+        if (e->ctx && e->src_w == src_w && e->src_h == src_h && e->src_fmt == src_fmt
+            && e->dst_w == dst_w && e->dst_h == dst_h && e->dst_fmt == dst_fmt && e->flags == flags)
+        {
+            e->last_used = ++gb_decoder_pool_clock;
+            return e->ctx;
+        }
+        if (!victim->ctx)
+            continue;
+        if (!e->ctx || e->last_used < victim->last_used)
+            victim = e;
+    }
+    if (victim->ctx)
+        sws_freeContext(victim->ctx);
+    victim->ctx = sws_getContext(src_w, src_h, src_fmt, dst_w, dst_h, dst_fmt, flags, NULL, NULL, NULL);
+    victim->src_w = src_w;
+    victim->src_h = src_h;
+    victim->src_fmt = src_fmt;
+    victim->dst_w = dst_w;
+    victim->dst_h = dst_h;
+    victim->dst_fmt = dst_fmt;
+    victim->flags = flags;
+    victim->last_used = ++gb_decoder_pool_clock;
+    return victim->ctx;
+}
+
+void decoder_pool_free()
+{
+    int i;
+    for (i = 0; i < DECODER_POOL_SIZE; i++)
+        if (gb_decoder_pool[i].ctx)
+            free_codec_context(&gb_decoder_pool[i].ctx);
+    for (i = 0; i < SWS_POOL_SIZE; i++)
+        if (gb_sws_pool[i].ctx)
+        {
+            sws_freeContext(gb_sws_pool[i].ctx);
+            gb_sws_pool[i].ctx = NULL;
+        }
+}
@@ -0,0 +1,36 @@
+#ifndef DECODER_POOL_H_
+#define DECODER_POOL_H_
+
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+
+/*
+open decoders & scaler kept across files of a batch. a decoder is handed
+out again (flushed) when the next file has the same codec parameters, so
+avcodec_open2() with its tables & threads only runs when they differ.
+*/
+struct decoder_key
+{
+    enum AVCodecID codec_id;
+    uint32_t codec_tag; // e.g. bug workarounds of mpeg4
+    int width, height;
+    int format;
+    int bits_per_coded_sample;
+    int profile, level;
+    int extradata_size;
+    uint32_t extradata_crc;
+    int thread_type, thread_count; // can't be changed once opened
+};
+
+#define DECODER_POOL_SIZE 4
+#define SWS_POOL_SIZE 4 // scalers of a file: rgb24 shots, tiles & gray shots
+
+void decoder_key_from_params(struct decoder_key *k, const AVCodecParameters *par);
+AVCodecContext *decoder_pool_get(const struct decoder_key *k);
+void decoder_pool_put(AVCodecContext *ctx, const struct decoder_key *k);
+struct SwsContext *decoder_pool_get_sws(int src_w, int src_h, enum AVPixelFormat src_fmt,
+    int dst_w, int dst_h, enum AVPixelFormat dst_fmt, int flags);
+void decoder_pool_free();
+
+#endif /* DECODER_POOL_H_ */
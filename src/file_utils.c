@@ -3,6 +3,8 @@
 #ifndef _WIN32
 #include <sys/stat.h>
 #include <string.h>
+#include <stdio.h>
+#include <utime.h>
 #endif
 
 int is_reg(const tchar_t *file)
@@ -52,7 +54,7 @@ filetime_t get_current_filetime()
 {
     FILETIME ft;
     GetSystemTimeAsFileTime(&ft);
-    return (uint64_t) ft.dwHighDateTime << 32 | ft.dwHighDateTime;
+    return (uint64_t) ft.dwHighDateTime << 32 | ft.dwLowDateTime;
 }
 #else
 filetime_t get_current_filetime()
@@ -66,7 +68,7 @@ int create_directory(const tchar_t *name)
 #ifdef _WIN32
     return CreateDirectory(name, NULL) ? 0 : -1;
 #else
-    return mkdir(name, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+    return mkdir(name, S_IRWXU | S_IRWXG | S_IRWXO); // umask applies
 #endif
 }
 
@@ -79,6 +81,59 @@ int delete_file(const tchar_t *name)
 #endif
 }
 
+/*
+get size & modification time of a regular file. return 0 if ok
+*/
+int get_file_info(const tchar_t *path, int64_t *size, filetime_t *mtime)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesEx(path, GetFileExInfoStandard, &data) || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        return -1;
+    *size = (int64_t) data.nFileSizeHigh << 32 | data.nFileSizeLow;
+    *mtime = *(const uint64_t *) &data.ftLastWriteTime;
+    return 0;
+#else
+    struct stat buf;
+    if (stat(path, &buf) || !S_ISREG(buf.st_mode))
+        return -1;
+    *size = buf.st_size;
+    *mtime = buf.st_mtime;
+    return 0;
+#endif
+}
+
+/*
+set modification time to now
+*/
+int touch_file(const tchar_t *path)
+{
+#ifdef _WIN32
+    HANDLE h = CreateFile(path, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+    if (h == INVALID_HANDLE_VALUE)
+        return -1;
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    BOOL ok = SetFileTime(h, NULL, NULL, &ft);
+    CloseHandle(h);
+    return ok ? 0 : -1;
+#else
+    return utime(path, NULL);
+#endif
+}
+
+/*
+replaces to if it exists
+*/
+int rename_file(const tchar_t *from, const tchar_t *to)
+{
+#ifdef _WIN32
+    return MoveFileEx(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(from, to);
+#endif
+}
+
 const char *basename(const char *path)
 {
     if (!path || !*path)
@@ -39,6 +39,9 @@ filetime_t get_current_filetime();
 
 int delete_file(const tchar_t *path);
 int create_directory(const tchar_t *path);
+int get_file_info(const tchar_t *path, int64_t *size, filetime_t *mtime);
+int touch_file(const tchar_t *path);
+int rename_file(const tchar_t *from, const tchar_t *to);
 
 const char *basename(const char *path);
 
@@ -0,0 +1,192 @@
+#include "glyph_atlas.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define WHITE gdTrueColor(255, 255, 255)
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+void glyph_atlas_init(struct glyph_atlas *ga)
+{
+    memset(ga, 0, sizeof(*ga));
+}
+
+void glyph_atlas_free(struct glyph_atlas *ga)
+{
+    free(ga->font);
+    free(ga->coverage);
+    glyph_atlas_init(ga);
+}
+
+static const struct atlas_glyph *find_glyph(const struct glyph_atlas *ga, char c)
+{
+    const char *p = c ? strchr(GLYPH_ATLAS_CHARS, c) : NULL;
+    return p ? &ga->glyphs[p - GLYPH_ATLAS_CHARS] : NULL;
+}
+
+/*
+rasterize the glyphs of font at size.
+returns NULL if success, otherwise returns error message; the atlas is
+closed then
+*/
+char *glyph_atlas_open(struct glyph_atlas *ga, const char *font, double size)
+{
+    int brect[8], i, x = 0, bottom = 0;
+    gdImagePtr ip = NULL;
+    char *err = NULL;
+
+    glyph_atlas_free(ga);
+    for (i = 0; GLYPH_ATLAS_CHARS[i]; i++)
+    {
+        struct atlas_glyph *g = &ga->glyphs[i];
+        char text[3] = { GLYPH_ATLAS_CHARS[i], GLYPH_ATLAS_CHARS[i], '\0' };
+        // gd places the glyphs at fractional pen positions; xshow has the advances
+        gdFTStringExtra strex;
+        memset(&strex, 0, sizeof(strex));
+        strex.flags = gdFTEX_XSHOW;
+        if ((err = gdImageStringFTEx(NULL, brect, WHITE, (char *) font, size, 0, 0, 0, text, &strex)))
+            goto error;
+        g->advance = -1;
+        if (strex.xshow)
+        {
+            g->advance = (int) (strtod(strex.xshow, NULL) * GLYPH_ATLAS_SUBPIXELS + 0.5);
+            gdFree(strex.xshow);
+        }
+        const int two_right = brect[2];
+        text[1] = '\0';
+        if ((err = gdImageStringFT(NULL, brect, WHITE, (char *) font, size, 0, 0, 0, text)))
+            goto error;
+        if (g->advance < 0)
+            g->advance = (two_right - brect[2]) * GLYPH_ATLAS_SUBPIXELS;
+        g->ink_left = brect[6];
+        g->ink_top = brect[7];
+        g->ink_right = brect[2];
+        g->ink_bottom = brect[3];
+        // the right edge is truncated in both brects; take the higher lower bound
+        g->right_edge = MAX(g->ink_right * GLYPH_ATLAS_SUBPIXELS, two_right * GLYPH_ATLAS_SUBPIXELS - g->advance);
+        g->x = x;
+        g->width = g->ink_right - g->ink_left + 1 + 2*GLYPH_ATLAS_MARGIN;
+        x += g->width;
+        if (g->ink_top < ga->top)
+            ga->top = g->ink_top;
+        if (g->ink_bottom > bottom)
+            bottom = g->ink_bottom;
+    }
+    ga->top -= GLYPH_ATLAS_MARGIN;
+    ga->width = x;
+    ga->height = bottom + GLYPH_ATLAS_MARGIN - ga->top + 1;
+
+    // white on black; the green of a pixel is the coverage
+    ip = gdImageCreateTrueColor(ga->width, ga->height);
+    ga->coverage = malloc(ga->width * ga->height);
+    ga->font = strdup(font);
+    if (!ip || !ga->coverage || !ga->font)
+    {
+        err = "out of memory";
+        goto error;
+    }
+    for (i = 0; GLYPH_ATLAS_CHARS[i]; i++)
+    {
+        const struct atlas_glyph *g = &ga->glyphs[i];
+        char text[2] = { GLYPH_ATLAS_CHARS[i], '\0' };
+        if ((err = gdImageStringFT(ip, brect, WHITE, (char *) font, size, 0,
+            g->x + GLYPH_ATLAS_MARGIN - g->ink_left, -ga->top, text)))
+            goto error;
+    }
+    for (i = 0; i < ga->height; i++)
+    {
+        int j;
+        for (j = 0; j < ga->width; j++)
+            ga->coverage[i * ga->width + j] = gdTrueColorGetGreen(ip->tpixels[i][j]);
+    }
+    ga->size = size;
+    gdImageDestroy(ip);
+    return NULL;
+
+  error:
+    if (ip)
+        gdImageDestroy(ip);
+    glyph_atlas_free(ga);
+    return err;
+}
+
+/*
+brect of text drawn at 0, 0 as gdImageStringFT() would return it.
+return 0 if ok, -1 if the atlas is closed or a character of text isn't in it
+*/
+int glyph_atlas_brect(const struct glyph_atlas *ga, const char *text, int brect[8])
+{
+    int pen = 0, left = 0, top = 0, right = 0, bottom = 0;
+    const char *p;
+    if (!ga->coverage || !*text)
+        return -1;
+    for (p = text; *p; p++)
+    {
+        const struct atlas_glyph *g = find_glyph(ga, *p);
+        if (!g)
+            return -1;
+        const int x = pen / GLYPH_ATLAS_SUBPIXELS;
+        if (p == text || x + g->ink_left < left)
+            left = x + g->ink_left;
+        if (p == text || (pen + g->right_edge) / GLYPH_ATLAS_SUBPIXELS > right)
+            right = (pen + g->right_edge) / GLYPH_ATLAS_SUBPIXELS;
+        if (p == text || g->ink_top < top)
+            top = g->ink_top;
+        if (p == text || g->ink_bottom > bottom)
+            bottom = g->ink_bottom;
+        pen += g->advance;
+    }
+    brect[0] = brect[6] = left;
+    brect[2] = brect[4] = right;
+    brect[1] = brect[3] = bottom;
+    brect[5] = brect[7] = top;
+    return 0;
+}
+
+/*
+blend color into the truecolor ip by the coverage of text's glyphs, with
+the baseline of the first one at x, y. characters not in the atlas are
+skipped; the clip rect of ip is respected
+*/
+void glyph_atlas_draw(const struct glyph_atlas *ga, gdImagePtr ip, int x, int y, uint32_t color, const char *text)
+{
+    const int r = (color >> 16) & 0xFF, g = (color >> 8) & 0xFF, b = color & 0xFF;
+    int cx1, cy1, cx2, cy2, pen = 0;
+
+    if (!ga->coverage || !ip->trueColor)
+        return;
+    gdImageGetClip(ip, &cx1, &cy1, &cx2, &cy2);
+    for (; *text; text++)
+    {
+        const struct atlas_glyph *gl = find_glyph(ga, *text);
+        if (!gl)
+            continue;
+        const int left = x + pen / GLYPH_ATLAS_SUBPIXELS + gl->ink_left - GLYPH_ATLAS_MARGIN, top = y + ga->top;
+        const int i0 = left < cx1 ? cx1 - left : 0;
+        const int i1 = left + gl->width - 1 > cx2 ? cx2 - left + 1 : gl->width;
+        int j;
+        for (j = top < cy1 ? cy1 - top : 0; j < ga->height && top + j <= cy2; j++)
+        {
+            const uint8_t *cov = ga->coverage + j * ga->width + gl->x;
+            int *dst = ip->tpixels[top + j] + left;
+            int i;
+            for (i = i0; i < i1; i++)
+            {
+                const int a = cov[i];
+                if (!a)
+                    continue;
+                const int d = dst[i];
+                if (a == 255)
+                {
+                    dst[i] = (d & 0x7F000000) | (int) (color & 0xFFFFFF);
+                    continue;
+                }
+                const int dr = (d >> 16) & 0xFF, dg = (d >> 8) & 0xFF, db = d & 0xFF;
+                dst[i] = (d & 0x7F000000)
+                    | ((r * a + dr * (255 - a) + 127) / 255) << 16
+                    | ((g * a + dg * (255 - a) + 127) / 255) << 8
+                    | ((b * a + db * (255 - a) + 127) / 255);
+            }
+        }
+        pen += gl->advance;
+    }
+}
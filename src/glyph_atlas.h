@@ -0,0 +1,41 @@
+#ifndef GLYPH_ATLAS_H_
+#define GLYPH_ATLAS_H_
+
+#include <stdint.h>
+#include <gd.h>
+
+/*
+glyphs of timestamps (digits & ':') in one font & size, rasterized once
+with gdImageStringFT() into an 8-bit coverage atlas and alpha-blitted into
+truecolor images afterwards, so freetype isn't run for every shot.
+*/
+
+#define GLYPH_ATLAS_CHARS "0123456789:"
+#define GLYPH_ATLAS_MARGIN 2 // pixels around the ink box of a glyph for antialiasing
+#define GLYPH_ATLAS_SUBPIXELS 100 // pen positions are in 1/100 pixel like gd's xshow
+
+struct atlas_glyph
+{
+    int x, width; // of the cell in the atlas
+    int ink_left, ink_top, ink_right, ink_bottom; // brect of the glyph drawn alone at 0, 0
+    int right_edge; // of the ink in 1/GLYPH_ATLAS_SUBPIXELS pixel
+    int advance; // to the next glyph in 1/GLYPH_ATLAS_SUBPIXELS pixel
+};
+
+struct glyph_atlas
+{
+    char *font;
+    double size;
+    int width, height;
+    int top; // of the cells relative to the baseline
+    uint8_t *coverage; // width x height; NULL if the atlas isn't open
+    struct atlas_glyph glyphs[sizeof(GLYPH_ATLAS_CHARS) - 1];
+};
+
+void glyph_atlas_init(struct glyph_atlas *ga);
+char *glyph_atlas_open(struct glyph_atlas *ga, const char *font, double size);
+int glyph_atlas_brect(const struct glyph_atlas *ga, const char *text, int brect[8]);
+void glyph_atlas_draw(const struct glyph_atlas *ga, gdImagePtr ip, int x, int y, uint32_t color, const char *text);
+void glyph_atlas_free(struct glyph_atlas *ga);
+
+#endif /* GLYPH_ATLAS_H_ */
@@ -0,0 +1,347 @@
+#include "http_cache.h"
+#include "file_utils.h"
+#include "scan_dir.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavformat/avformat.h>
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#define TMP_STALE_AGE (3600ULL * 10000000) // in 100 ns
+#else
+#define TMP_STALE_AGE 3600 // in seconds
+#endif
+
+#define BLOCK_SUFFIX ".blk"
+#define TMP_SUFFIX ".tmp" // blocks being written; left over if a run crashed
+
+struct cache_file
+{
+    char *path;
+    int64_t size;
+    filetime_t mtime;
+};
+
+struct cache_scan
+{
+    int count;
+    int alloc;
+    struct cache_file *files;
+    int64_t total;
+    filetime_t now;
+};
+
+static int64_t gb_cache_used = -1; // bytes in the cache directory; -1 = not scanned yet
+
+int http_cache_is_url(const char *url)
+{
+    return !strncmp(url, "http://", 7) || !strncmp(url, "https://", 8);
+}
+
+void http_cache_init(struct http_cache *hc)
+{
+    memset(hc, 0, sizeof(*hc));
+    hc->block_idx = -1;
+}
+
+static int has_suffix(const char *path, size_t len, const char *suffix)
+{
+    return len > strlen(suffix) && !strcmp(path + len - strlen(suffix), suffix);
+}
+
+static void scan_func(void *context, const tchar_t *tpath)
+{
+    struct cache_scan *cs = context;
+    const char *path = tchar_to_utf8(tpath);
+    size_t len = strlen(path);
+    struct cache_file f;
+    if (has_suffix(path, len, TMP_SUFFIX) && !get_file_info(tpath, &f.size, &f.mtime))
+    {
+        // blocks are written in seconds; older ones are from crashed runs
+        if (f.mtime + TMP_STALE_AGE < cs->now && !delete_file(tpath))
+            goto done;
+        cs->total += f.size;
+    }
+    else if (has_suffix(path, len, BLOCK_SUFFIX) && !get_file_info(tpath, &f.size, &f.mtime))
+    {
+        if (cs->count == cs->alloc)
+        {
+            int alloc = cs->alloc ? 2 * cs->alloc : 256;
+            struct cache_file *files = realloc(cs->files, alloc * sizeof(*files));
+            if (!files)
+                goto done;
+            cs->files = files;
+            cs->alloc = alloc;
+        }
+        f.path = strdup(path);
+        if (f.path)
+        {
+            cs->files[cs->count++] = f;
+            cs->total += f.size;
+        }
+    }
+  done:
+    free_conv_result(path);
+}
+
+static int cmp_mtime(const void *a, const void *b)
+{
+    const struct cache_file *fa = a, *fb = b;
+    return fa->mtime < fb->mtime ? -1 : fa->mtime > fb->mtime;
+}
+
+/*
+remove least recently used blocks until the cache is under 90% of its size;
+without max_size only the used size is counted. blocks left half written
+by crashed runs are removed too
+*/
+static void evict(const char *root, int64_t max_size)
+{
+    struct cache_scan cs = { 0, 0, NULL, 0, get_current_filetime() };
+    const tchar_t *troot = utf8_to_tchar(root);
+    scan_dir(troot, scan_func, &cs, 1);
+    free_conv_result(troot);
+
+    int i;
+    if (max_size > 0 && cs.total > max_size)
+    {
+        qsort(cs.files, cs.count, sizeof(*cs.files), cmp_mtime);
+        for (i = 0; i < cs.count && cs.total > max_size / 10 * 9; i++)
+        {
+            const tchar_t *tpath = utf8_to_tchar(cs.files[i].path);
+            if (!delete_file(tpath))
+                cs.total -= cs.files[i].size;
+            free_conv_result(tpath);
+        }
+    }
+    gb_cache_used = cs.total;
+    for (i = 0; i < cs.count; i++)
+        free(cs.files[i].path);
+    free(cs.files);
+}
+
+static char *block_path(const struct http_cache *hc, int64_t idx, const char *suffix)
+{
+    char *path = malloc(strlen(hc->dir) + strlen(suffix) + 32);
+    if (path)
+        sprintf(path, "%s/%08"PRId64"%s", hc->dir, idx, suffix);
+    return path;
+}
+
+/*
+return 0 if the whole block is in the cache
+*/
+static int read_cached_block(struct http_cache *hc, int64_t idx, int len)
+{
+    char *path = block_path(hc, idx, BLOCK_SUFFIX);
+    if (!path)
+        return -1;
+    int result = -1;
+    const tchar_t *tpath = utf8_to_tchar(path);
+    FILE *fp = _tfopen(tpath, _T("rb"));
+    if (fp)
+    {
+        if (fread(hc->block_data, 1, len, fp) == (size_t) len)
+            result = 0;
+        fclose(fp);
+        if (!result)
+            touch_file(tpath); // recently used
+    }
+    free_conv_result(tpath);
+    free(path);
+    return result;
+}
+
+static void write_cached_block(struct http_cache *hc, int64_t idx, int len)
+{
+    // written under a name of its own, so other processes & inputs never see a partial block
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%d-%p" TMP_SUFFIX, (int) getpid(), (void *) hc);
+    char *tmp = block_path(hc, idx, suffix);
+    char *path = block_path(hc, idx, BLOCK_SUFFIX);
+    const tchar_t *ttmp = utf8_to_tchar(tmp);
+    const tchar_t *tpath = utf8_to_tchar(path);
+    FILE *fp = tmp && path ? _tfopen(ttmp, _T("wb")) : NULL;
+    if (fp)
+    {
+        int ok = fwrite(hc->block_data, 1, len, fp) == (size_t) len;
+        if (fclose(fp) || !ok || rename_file(ttmp, tpath))
+            delete_file(ttmp);
+        else if ((gb_cache_used += len) > hc->max_size)
+            evict(hc->root, hc->max_size);
+    }
+    free_conv_result(ttmp);
+    free_conv_result(tpath);
+    free(tmp);
+    free(path);
+}
+
+static int load_block(struct http_cache *hc, int64_t idx)
+{
+    if (idx == hc->block_idx)
+        return 0;
+    int64_t start = idx * HTTP_CACHE_BLOCK;
+    int len = (int) (hc->size - start < HTTP_CACHE_BLOCK ? hc->size - start : HTTP_CACHE_BLOCK);
+    hc->block_idx = -1;
+    if (!read_cached_block(hc, idx, len))
+    {
+        hc->nb_hits++;
+        hc->block_idx = idx;
+        hc->block_len = len;
+        return 0;
+    }
+
+    int64_t ret = avio_seek(hc->remote, start, SEEK_SET);
+    if (ret < 0)
+        return (int) ret;
+    int n = 0;
+    while (n < len)
+    {
+        int r = avio_read(hc->remote, hc->block_data + n, len - n);
+        if (r <= 0)
+            return r < 0 ? r : AVERROR_EOF;
+        n += r;
+    }
+    hc->nb_fetched++;
+    hc->block_idx = idx;
+    hc->block_len = len;
+    write_cached_block(hc, idx, len);
+    return 0;
+}
+
+static int read_packet(void *opaque, uint8_t *buf, int buf_size)
+{
+    struct http_cache *hc = opaque;
+    if (hc->pos >= hc->size)
+        return AVERROR_EOF;
+    int ret = load_block(hc, hc->pos / HTTP_CACHE_BLOCK);
+    if (ret < 0)
+        return ret;
+    int offset = (int) (hc->pos - hc->block_idx * HTTP_CACHE_BLOCK);
+    if (buf_size > hc->block_len - offset)
+        buf_size = hc->block_len - offset;
+    memcpy(buf, hc->block_data + offset, buf_size);
+    hc->pos += buf_size;
+    return buf_size;
+}
+
+static int64_t seek(void *opaque, int64_t offset, int whence)
+{
+    struct http_cache *hc = opaque;
+    int64_t pos;
+    switch (whence & ~AVSEEK_FORCE)
+    {
+    case AVSEEK_SIZE:
+        return hc->size;
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = hc->pos + offset;
+        break;
+    case SEEK_END:
+        pos = hc->size + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+    hc->pos = pos; // the server is only asked when a block is missing
+    return pos;
+}
+
+/* 64-bit FNV-1a */
+static uint64_t hash_string(const char *s)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    while (*s)
+    {
+        h ^= (unsigned char) *s++;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/*
+open url through the cache in directory root. the server can't tell us
+an etag, so blocks are kept per url & size of the file.
+return 0 if hc->pb can be used for avformat_open_input()
+*/
+int http_cache_open(struct http_cache *hc, const char *url, const char *root, int max_size_mb, AVDictionary *options)
+{
+    http_cache_init(hc);
+    hc->root = root;
+    hc->max_size = (int64_t) max_size_mb << 20;
+
+    AVDictionary *dict = NULL;
+    if (options)
+        av_dict_copy(&dict, options, 0);
+    int ret = avio_open2(&hc->remote, url, AVIO_FLAG_READ, NULL, &dict);
+    av_dict_free(&dict);
+    if (ret < 0)
+        return ret;
+    hc->size = avio_size(hc->remote);
+    if (hc->size <= 0 || !(hc->remote->seekable & AVIO_SEEKABLE_NORMAL))
+        goto error; // can't be cached in blocks
+
+    const tchar_t *troot = utf8_to_tchar(root);
+    if (!is_dir(troot))
+        create_directory(troot);
+    free_conv_result(troot);
+    hc->dir = malloc(strlen(root) + 64);
+    if (!hc->dir)
+        goto error;
+    sprintf(hc->dir, "%s/%016"PRIx64"-%"PRId64, root, hash_string(url), hc->size);
+    const tchar_t *tdir = utf8_to_tchar(hc->dir);
+    int dir_ok = is_dir(tdir) || !create_directory(tdir);
+    free_conv_result(tdir);
+    if (!dir_ok)
+        goto error;
+    if (gb_cache_used < 0)
+        evict(root, hc->max_size);
+
+    hc->block_data = av_malloc(HTTP_CACHE_BLOCK);
+    unsigned char *buffer = av_malloc(HTTP_CACHE_BUFFER);
+    if (!hc->block_data || !buffer)
+    {
+        av_free(buffer);
+        goto error;
+    }
+    hc->pb = avio_alloc_context(buffer, HTTP_CACHE_BUFFER, 0, hc, read_packet, NULL, seek);
+    if (!hc->pb)
+    {
+        av_free(buffer);
+        goto error;
+    }
+    return 0;
+
+  error:
+    http_cache_close(hc);
+    return -1;
+}
+
+void http_cache_close(struct http_cache *hc)
+{
+    if (hc->remote)
+        av_log(NULL, AV_LOG_VERBOSE, "  http cache: %d blocks from cache, %d from server\n", hc->nb_hits, hc->nb_fetched);
+    if (hc->pb)
+    {
+        av_freep(&hc->pb->buffer);
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(57, 80, 100)
+        avio_context_free(&hc->pb);
+#else
+        av_freep(&hc->pb);
+#endif
+    }
+    if (hc->remote)
+        avio_closep(&hc->remote);
+    av_free(hc->block_data);
+    free(hc->dir);
+    http_cache_init(hc);
+}
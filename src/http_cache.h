@@ -0,0 +1,39 @@
+#ifndef HTTP_CACHE_H_
+#define HTTP_CACHE_H_
+
+#include <stdint.h>
+#include <libavformat/avio.h>
+#include <libavutil/dict.h>
+
+/*
+on-disk block cache for http(s) inputs. the file is read in blocks which
+are kept in a directory per url & size, so later seeks & runs with other
+layouts are served from disk. the least recently used blocks are removed
+when the cache grows over its size.
+*/
+struct http_cache
+{
+    AVIOContext *remote; // NULL = not open
+    AVIOContext *pb;     // reads through the cache
+    char *dir;           // of this input's blocks
+    const char *root;    // cache directory (--http-cache)
+    int64_t max_size;    // of the whole cache, in bytes
+    int64_t size;        // of the input
+    int64_t pos;
+    int64_t block_idx;   // block in block_data; -1 = none
+    int block_len;
+    uint8_t *block_data;
+    int nb_fetched;      // # of blocks read from the server
+    int nb_hits;         // # of blocks read from the cache
+};
+
+#define HTTP_CACHE_BLOCK (1 << 20)
+#define HTTP_CACHE_SIZE 1024 // in MiB
+#define HTTP_CACHE_BUFFER 65536
+
+int http_cache_is_url(const char *url);
+void http_cache_init(struct http_cache *hc);
+int http_cache_open(struct http_cache *hc, const char *url, const char *root, int max_size_mb, AVDictionary *options);
+void http_cache_close(struct http_cache *hc);
+
+#endif /* HTTP_CACHE_H_ */
@@ -0,0 +1,260 @@
+#include "incremental.h"
+#include "file_utils.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INC_STATE_VERSION 1
+#define INC_TILES_SUFFIX ".png"
+#define INC_TMP_SUFFIX ".tmp" // files being written; renamed when complete
+
+void inc_state_init(struct inc_state *s)
+{
+    memset(s, 0, sizeof(*s));
+}
+
+/*
+return -1 if failed
+*/
+int inc_state_alloc(struct inc_state *s, int nb_tiles, int tile_w, int tile_h)
+{
+    free(s->pts);
+    if (s->tiles)
+        gdImageDestroy(s->tiles);
+    s->pts = NULL;
+    s->tiles = NULL;
+    s->nb_tiles = 0;
+    s->tile_w = tile_w;
+    s->tile_h = tile_h;
+    if (nb_tiles <= 0)
+        return 0;
+
+    int rows = (nb_tiles + INC_TILE_COLUMNS - 1) / INC_TILE_COLUMNS;
+    int cols = nb_tiles < INC_TILE_COLUMNS ? nb_tiles : INC_TILE_COLUMNS;
+    s->pts = malloc(nb_tiles * sizeof(*s->pts));
+    s->tiles = gdImageCreateTrueColor(cols * tile_w, rows * tile_h);
+    if (!s->pts || !s->tiles)
+        return -1;
+    s->nb_tiles = nb_tiles;
+    return 0;
+}
+
+static char *suffixed_filename(const char *filename, const char *suffix)
+{
+    char *name = malloc(strlen(filename) + strlen(suffix) + 1);
+    if (name)
+    {
+        strcpy(name, filename);
+        strcat(name, suffix);
+    }
+    return name;
+}
+
+static char *tiles_filename(const char *filename)
+{
+    return suffixed_filename(filename, INC_TILES_SUFFIX);
+}
+
+/*
+return 0 if state is loaded; -1 if it doesn't exist or is invalid
+*/
+int inc_state_load(struct inc_state *s, const char *filename)
+{
+    int result = -1;
+    char line[256];
+    int version = 0, nb_tiles = 0, i = 0;
+    const tchar_t *tname = utf8_to_tchar(filename);
+    FILE *fp = _tfopen(tname, _T("r"));
+    free_conv_result(tname);
+    if (!fp)
+        return -1;
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        int64_t pts;
+        if (sscanf(line, "mtn incremental %d", &version) == 1
+            || sscanf(line, "time_base %d %d", &s->tb_num, &s->tb_den) == 2
+            || sscanf(line, "first %"SCNd64, &s->first_target) == 1
+            || sscanf(line, "step %"SCNd64, &s->step_t) == 1
+            || sscanf(line, "targets %d", &s->nb_targets) == 1
+            || sscanf(line, "sprite %d %"SCNd64, &s->sprite_file_idx, &s->sprite_last_pts) == 2)
+            continue;
+        if (sscanf(line, "tiles %d %d %d", &nb_tiles, &s->tile_w, &s->tile_h) == 3)
+        {
+            if (version != INC_STATE_VERSION || inc_state_alloc(s, nb_tiles, s->tile_w, s->tile_h) == -1)
+                goto cleanup;
+            continue;
+        }
+        if (sscanf(line, "pts %"SCNd64, &pts) == 1 && i < s->nb_tiles)
+            s->pts[i++] = pts;
+    }
+    if (version != INC_STATE_VERSION || i != s->nb_tiles || s->nb_targets < s->nb_tiles)
+        goto cleanup;
+
+    if (s->nb_tiles)
+    {
+        char *tname8 = tiles_filename(filename);
+        const tchar_t *ttiles = utf8_to_tchar(tname8);
+        FILE *tfp = _tfopen(ttiles, _T("rb"));
+        free_conv_result(ttiles);
+        free(tname8);
+        if (!tfp)
+            goto cleanup;
+        gdImagePtr tiles = gdImageCreateFromPng(tfp);
+        fclose(tfp);
+        if (!tiles || gdImageSX(tiles) < gdImageSX(s->tiles) || gdImageSY(tiles) < gdImageSY(s->tiles))
+        {
+            if (tiles)
+                gdImageDestroy(tiles);
+            goto cleanup;
+        }
+        gdImageDestroy(s->tiles);
+        s->tiles = tiles;
+    }
+    result = 0;
+
+  cleanup:
+    fclose(fp);
+    if (result)
+        inc_state_free(s);
+    return result;
+}
+
+/*
+write the tiles of s to filename as png
+return 0 if ok
+*/
+static int save_tiles(const struct inc_state *s, const char *filename)
+{
+    int result = -1;
+    const tchar_t *tname = utf8_to_tchar(filename);
+    FILE *fp = _tfopen(tname, _T("wb"));
+    free_conv_result(tname);
+    if (fp)
+    {
+        // tiles are kept lossless, the sheet itself might be a jpeg
+        gdImagePngEx(s->tiles, fp, 1); // fast; rewritten on every run
+        if (!fclose(fp))
+            result = 0;
+    }
+    return result;
+}
+
+/*
+write the state of s to filename
+return 0 if ok
+*/
+static int save_state(const struct inc_state *s, const char *filename)
+{
+    int i;
+    const tchar_t *tname = utf8_to_tchar(filename);
+    FILE *fp = _tfopen(tname, _T("w"));
+    free_conv_result(tname);
+    if (!fp)
+        return -1;
+
+    fprintf(fp, "mtn incremental %d\n", INC_STATE_VERSION);
+    fprintf(fp, "time_base %d %d\n", s->tb_num, s->tb_den);
+    fprintf(fp, "first %"PRId64"\n", s->first_target);
+    fprintf(fp, "step %"PRId64"\n", s->step_t);
+    fprintf(fp, "targets %d\n", s->nb_targets);
+    fprintf(fp, "sprite %d %"PRId64"\n", s->sprite_file_idx, s->sprite_last_pts);
+    fprintf(fp, "tiles %d %d %d\n", s->nb_tiles, s->tile_w, s->tile_h);
+    for (i = 0; i < s->nb_tiles; i++)
+        fprintf(fp, "pts %"PRId64"\n", s->pts[i]);
+    return fclose(fp) ? -1 : 0;
+}
+
+static void remove_file(const char *filename)
+{
+    const tchar_t *tname = utf8_to_tchar(filename);
+    delete_file(tname);
+    free_conv_result(tname);
+}
+
+/*
+rename complete file from to to; from is deleted if it fails
+return 0 if ok
+*/
+static int replace_file(const char *from, const char *to)
+{
+    const tchar_t *tfrom = utf8_to_tchar(from);
+    const tchar_t *tto = utf8_to_tchar(to);
+    int result = rename_file(tfrom, tto);
+    free_conv_result(tfrom);
+    free_conv_result(tto);
+    if (result)
+        remove_file(from);
+    return result;
+}
+
+/*
+save the state to filename & its tiles next to it. both are written under
+temporary names first & the tiles are renamed before the state, so a run
+killed in between leaves a state whose tiles are all in the atlas
+return 0 if state is saved
+*/
+int inc_state_save(const struct inc_state *s, const char *filename)
+{
+    int result = -1;
+    char *tiles_name = tiles_filename(filename);
+    char *tiles_tmp = tiles_name ? suffixed_filename(tiles_name, INC_TMP_SUFFIX) : NULL;
+    char *state_tmp = suffixed_filename(filename, INC_TMP_SUFFIX);
+    if (!tiles_tmp || !state_tmp)
+        goto cleanup;
+
+    if (s->nb_tiles)
+    {
+        if (save_tiles(s, tiles_tmp))
+        {
+            remove_file(tiles_tmp);
+            goto cleanup;
+        }
+        if (replace_file(tiles_tmp, tiles_name))
+            goto cleanup;
+    }
+    if (save_state(s, state_tmp))
+    {
+        remove_file(state_tmp);
+        goto cleanup;
+    }
+    result = replace_file(state_tmp, filename);
+
+  cleanup:
+    free(tiles_name);
+    free(tiles_tmp);
+    free(state_tmp);
+    return result;
+}
+
+/*
+copy tile idx from src at src_x, src_y
+*/
+void inc_state_put_tile(struct inc_state *s, int idx, gdImagePtr src, int src_x, int src_y)
+{
+    gdImageCopy(s->tiles, src,
+        idx % INC_TILE_COLUMNS * s->tile_w, idx / INC_TILE_COLUMNS * s->tile_h,
+        src_x, src_y, s->tile_w, s->tile_h);
+}
+
+/*
+return a new image with tile idx, NULL if failed
+*/
+gdImagePtr inc_state_get_tile(const struct inc_state *s, int idx)
+{
+    gdImagePtr ip = gdImageCreateTrueColor(s->tile_w, s->tile_h);
+    if (ip)
+        gdImageCopy(ip, s->tiles, 0, 0,
+            idx % INC_TILE_COLUMNS * s->tile_w, idx / INC_TILE_COLUMNS * s->tile_h,
+            s->tile_w, s->tile_h);
+    return ip;
+}
+
+void inc_state_free(struct inc_state *s)
+{
+    free(s->pts);
+    if (s->tiles)
+        gdImageDestroy(s->tiles);
+    inc_state_init(s);
+}
@@ -0,0 +1,36 @@
+#ifndef INCREMENTAL_H_
+#define INCREMENTAL_H_
+
+#include <stdint.h>
+#include <gd.h>
+
+/*
+state of a thumbnail kept between runs for a file which is still growing
+(e.g. a recording). tiles already in the sheet & where the sprite chunks
+ended are stored, so the next run only decodes the new part of the file.
+*/
+struct inc_state
+{
+    int tb_num, tb_den;     // time base of the video stream
+    int64_t first_target;   // in time_base units
+    int64_t step_t;         // in time_base units
+    int tile_w, tile_h;     // size of a tile in the sheet
+    int nb_targets;         // # of planned shots already taken or skipped
+    int nb_tiles;
+    int64_t *pts;           // pts of each tile
+    gdImagePtr tiles;       // tiles in rows of INC_TILE_COLUMNS
+    int sprite_file_idx;    // index of the next sprite chunk
+    int64_t sprite_last_pts;
+};
+
+#define INC_TILE_COLUMNS 16
+
+void inc_state_init(struct inc_state *s);
+int inc_state_alloc(struct inc_state *s, int nb_tiles, int tile_w, int tile_h);
+int inc_state_load(struct inc_state *s, const char *filename);
+int inc_state_save(const struct inc_state *s, const char *filename);
+void inc_state_put_tile(struct inc_state *s, int idx, gdImagePtr src, int src_x, int src_y);
+gdImagePtr inc_state_get_tile(const struct inc_state *s, int idx);
+void inc_state_free(struct inc_state *s);
+
+#endif /* INCREMENTAL_H_ */
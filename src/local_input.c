@@ -0,0 +1,279 @@
+#include "local_input.h"
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+#include <libavformat/avformat.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+void local_input_init(struct local_input *li)
+{
+    li->fd = -1;
+    li->size = -1;
+    li->pos = 0;
+    li->run_start = 0;
+    li->offset = 0;
+    li->map = NULL;
+    li->map_size = 0;
+    li->pb = NULL;
+}
+
+/*
+hand an open input over to dst, e.g. from the thread which probed it;
+src is left closed
+*/
+void local_input_move(struct local_input *dst, struct local_input *src)
+{
+    *dst = *src;
+    if (dst->pb)
+        dst->pb->opaque = dst; // callbacks find the input through it
+    local_input_init(src);
+}
+
+#ifdef _WIN32
+// default file protocol is used on windows
+int local_input_open(struct local_input *li, const char *filename, int buffer_size, int use_mmap)
+{
+    (void) li; (void) filename; (void) buffer_size; (void) use_mmap;
+    return -1;
+}
+
+int local_input_open_range(struct local_input *li, const char *filename, int64_t offset, int64_t size,
+    int buffer_size, int use_mmap)
+{
+    (void) li; (void) filename; (void) offset; (void) size; (void) buffer_size; (void) use_mmap;
+    return -1;
+}
+
+void local_input_set_sequential(struct local_input *li, int sequential)
+{
+    (void) li; (void) sequential;
+}
+
+void local_input_willneed(struct local_input *li, int64_t pos, int64_t size)
+{
+    (void) li; (void) pos; (void) size;
+}
+
+void local_input_close(struct local_input *li)
+{
+    (void) li;
+}
+#else
+
+static void advise(struct local_input *li, int64_t pos, int64_t size, int advice)
+{
+#ifdef POSIX_FADV_WILLNEED
+    if (size > 0)
+        posix_fadvise(li->fd, li->offset + pos, size, advice);
+#else
+    (void) li; (void) pos; (void) size; (void) advice;
+#endif
+}
+
+/*
+madvise() needs page aligned addresses
+*/
+static void advise_map(struct local_input *li, int64_t pos, int64_t size, int advice)
+{
+    static long page_size = 0;
+    if (!page_size)
+        page_size = sysconf(_SC_PAGESIZE);
+    if (pos + size > li->size)
+        size = li->size - pos;
+    if (size <= 0 || page_size <= 0)
+        return;
+    pos += li->offset;
+    int64_t start = pos / page_size * page_size;
+    madvise((uint8_t *) li->map + start, pos + size - start, advice);
+}
+
+/*
+pages which were read sequentially & are far enough behind are dropped
+*/
+static void drop_behind(struct local_input *li)
+{
+    int64_t end = li->pos - LOCAL_INPUT_KEEP;
+    if (end - li->run_start < LOCAL_INPUT_KEEP)
+        return;
+    // pages stay in the page cache as long as they are mapped
+    if (li->map)
+        advise_map(li, li->run_start, end - li->run_start, MADV_DONTNEED);
+#ifdef POSIX_FADV_DONTNEED
+    advise(li, li->run_start, end - li->run_start, POSIX_FADV_DONTNEED);
+#endif
+    li->run_start = end;
+}
+
+static int read_map(void *opaque, uint8_t *buf, int buf_size)
+{
+    struct local_input *li = opaque;
+    if (li->pos >= li->size)
+        return AVERROR_EOF;
+    if (buf_size > li->size - li->pos)
+        buf_size = (int) (li->size - li->pos);
+    memcpy(buf, li->map + li->offset + li->pos, buf_size);
+    li->pos += buf_size;
+    drop_behind(li);
+    return buf_size;
+}
+
+static int read_packet(void *opaque, uint8_t *buf, int buf_size)
+{
+    struct local_input *li = opaque;
+    ssize_t n;
+    if (buf_size > li->size - li->pos)
+        buf_size = li->pos < li->size ? (int) (li->size - li->pos) : 0;
+    if (buf_size == 0)
+        return AVERROR_EOF;
+    do
+        n = pread(li->fd, buf, buf_size, li->offset + li->pos);
+    while (n < 0 && errno == EINTR);
+    if (n < 0)
+        return AVERROR(errno);
+    if (n == 0)
+        return AVERROR_EOF;
+    li->pos += n;
+    drop_behind(li);
+    return (int) n;
+}
+
+static int64_t seek(void *opaque, int64_t offset, int whence)
+{
+    struct local_input *li = opaque;
+    int64_t pos;
+    switch (whence & ~AVSEEK_FORCE)
+    {
+    case AVSEEK_SIZE:
+        return li->size;
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = li->pos + offset;
+        break;
+    case SEEK_END:
+        pos = li->size + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+    if (pos < li->run_start || pos > li->pos + LOCAL_INPUT_KEEP)
+        li->run_start = pos; // a new sequential run
+    li->pos = pos;
+    return pos;
+}
+
+/*
+open size bytes at offset of filename (e.g. a member of an archive) as
+if it was a file; size -1 = up to the end of the file.
+return 0 if li->pb can be used for avformat_open_input()
+*/
+int local_input_open_range(struct local_input *li, const char *filename, int64_t offset, int64_t size,
+    int buffer_size, int use_mmap)
+{
+    struct stat st;
+    local_input_init(li);
+    if (buffer_size <= 0 || offset < 0)
+        return -1;
+    li->fd = open(filename, O_RDONLY);
+    if (li->fd < 0)
+        return -1;
+    if (fstat(li->fd, &st) || !S_ISREG(st.st_mode) || offset > st.st_size)
+        goto error;
+    if (size < 0)
+        size = st.st_size - offset;
+    if (offset + size > st.st_size)
+        goto error;
+    li->offset = offset;
+    li->size = size;
+
+    // mapping might fail for large files on 32-bit systems; pread() is used then
+    if (use_mmap && st.st_size > 0 && (uint64_t) st.st_size <= SIZE_MAX)
+    {
+        void *map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, li->fd, 0);
+        if (map != MAP_FAILED)
+        {
+            li->map = map;
+            li->map_size = st.st_size;
+        }
+    }
+
+    unsigned char *buffer = av_malloc(buffer_size);
+    if (!buffer)
+        goto error;
+    li->pb = avio_alloc_context(buffer, buffer_size, 0, li, li->map ? read_map : read_packet, NULL, seek);
+    if (!li->pb)
+    {
+        av_free(buffer);
+        goto error;
+    }
+    // packets are copied straight from the mapping & seeks cost nothing
+    if (li->map)
+        li->pb->direct = 1;
+    return 0;
+
+  error:
+    local_input_close(li);
+    return -1;
+}
+
+int local_input_open(struct local_input *li, const char *filename, int buffer_size, int use_mmap)
+{
+    return local_input_open_range(li, filename, 0, -1, buffer_size, use_mmap);
+}
+
+/*
+tell the kernel that the range will be read soon; it's read ahead
+asynchronously while the current shot is decoded
+*/
+void local_input_willneed(struct local_input *li, int64_t pos, int64_t size)
+{
+    if (li->fd < 0 || pos < 0 || pos >= li->size)
+        return;
+    if (size < 0)
+        size = LOCAL_INPUT_PREFETCH_SIZE;
+    if (li->map)
+        advise_map(li, pos, size, MADV_WILLNEED);
+#ifdef POSIX_FADV_WILLNEED
+    else
+        advise(li, pos, size, POSIX_FADV_WILLNEED);
+#endif
+}
+
+/*
+tell the kernel how the mapping is going to be read: sequentially in
+non-seek mode, randomly in seek mode
+*/
+void local_input_set_sequential(struct local_input *li, int sequential)
+{
+    if (li->map)
+        advise_map(li, 0, li->size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+}
+
+void local_input_close(struct local_input *li)
+{
+    if (li->pb)
+    {
+        av_freep(&li->pb->buffer);
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(57, 80, 100)
+        avio_context_free(&li->pb);
+#else
+        av_freep(&li->pb);
+#endif
+    }
+    if (li->map)
+        munmap((void *) li->map, (size_t) li->map_size);
+    if (li->fd >= 0)
+        close(li->fd);
+    local_input_init(li);
+}
+#endif
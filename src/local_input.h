@@ -0,0 +1,38 @@
+#ifndef LOCAL_INPUT_H_
+#define LOCAL_INPUT_H_
+
+#include <stdint.h>
+#include <libavformat/avio.h>
+
+/*
+AVIOContext for local files with a large buffer. the kernel is told which
+parts of the file will be needed (planned shots) & which ones are done
+(already read in a sequential run), so seeks don't end in cold reads and
+long non-seek runs don't fill the page cache with the whole movie.
+*/
+struct local_input
+{
+    int fd; // -1 = not open
+    int64_t size;       // of the range
+    int64_t pos;        // position of the next read in the range
+    int64_t run_start;  // start of the current sequential run; nothing before it is dropped
+    int64_t offset;     // start of the range in the file, e.g. a member of an archive
+    const uint8_t *map; // whole file if mapped (--mmap); NULL = read with pread()
+    int64_t map_size;
+    AVIOContext *pb;
+};
+
+#define LOCAL_INPUT_BUFFER_SIZE 1024 // in KiB
+#define LOCAL_INPUT_KEEP (8 << 20) // bytes kept in page cache behind the current position
+#define LOCAL_INPUT_PREFETCH_SIZE (4 << 20) // bytes hinted when the range of a shot isn't indexed
+
+void local_input_init(struct local_input *li);
+void local_input_move(struct local_input *dst, struct local_input *src);
+int local_input_open(struct local_input *li, const char *filename, int buffer_size, int use_mmap);
+int local_input_open_range(struct local_input *li, const char *filename, int64_t offset, int64_t size,
+    int buffer_size, int use_mmap);
+void local_input_set_sequential(struct local_input *li, int sequential);
+void local_input_willneed(struct local_input *li, int64_t pos, int64_t size);
+void local_input_close(struct local_input *li);
+
+#endif /* LOCAL_INPUT_H_ */
@@ -35,6 +35,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <locale.h>
 #include <math.h>
 #include <stdio.h>
@@ -45,15 +46,31 @@
 #include <gd.h>
 
 #include "options.h"
+#include "archive.h"
+#include "decoder_pool.h"
 #include "file_utils.h"
+#include "glyph_atlas.h"
+#include "http_cache.h"
+#include "incremental.h"
+#include "local_input.h"
 #include "measure_time.h"
+#include "pixel_ops.h"
+#include "probe_pool.h"
+#include "pyramid.h"
+#include "render_cache.h"
 #include "scan_dir.h"
+#include "shot_plan.h"
 #include "string_buffer.h"
 
 #include <libavutil/imgutils.h>
 #include <libavutil/avutil.h>
+#include <libavutil/cpu.h>
 #include <libavutil/display.h>
+#include <libavutil/pixdesc.h>
 #include <libavcodec/avcodec.h>
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58, 87, 100)
+#include <libavcodec/bsf.h>
+#endif
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 
@@ -72,9 +89,11 @@
 #endif
 
 #ifdef _WIN32
+    #define TEXT_READ_MODE    _T("rt")
     #define TEXT_WRITE_MODE   _T("wt")
     #define BINARY_WRITE_MODE _T("wb")
 #else
+    #define TEXT_READ_MODE    "r"
     #define TEXT_WRITE_MODE   "w"
     #define BINARY_WRITE_MODE "w"
 #endif
@@ -83,6 +102,9 @@
 #define EDGE_FOUND 0.0001 // edge is considered found
 #define CMP_EDGE 180
 
+#define INC_STATE_SUFFIX ".inc" // state of --incremental, appended to output filename
+#define PREFETCH_SHOTS 3 // # of planned shots whose data is read ahead in seek mode
+
 #define IMAGE_EXTENSION_JPG ".jpg"
 #define IMAGE_EXTENSION_PNG ".png"
 #define LIBGD_FONT_HEIGHT_CORRECTION 1
@@ -116,6 +138,24 @@ struct thumbnail
     int64_t *ppts; // array of pts value of each shot
 };
 
+/* shots scaled straight into the tiles of the output image */
+struct tile_scaler
+{
+    struct SwsContext *pSwsCtx; // to AV_PIX_FMT_0RGB32; owned by decoder pool
+    AVFrame *frame; // shot_width_in x shot_height_in; for tiles which can't be written directly
+    int **rows;     // of frame
+    int stride;     // of out_ip rows in pixels; 0 = not equally spaced
+};
+
+/* gray shot of the decoded frame for blank & edge evasion */
+struct gray_shot
+{
+    struct SwsContext *pSwsCtx; // to gray8; owned by decoder pool; NULL = not used
+    int luma_plane; // 1 = scaled from the luma plane only
+    uint8_t *data; // width x height, no padding
+    int width, height;
+};
+
 struct sprite
 {
     gdImagePtr ip;
@@ -153,6 +193,9 @@ static int V_DEBUG = 0;
 const char *gb_argv0 = NULL;
 const char *gb_version = "3.4.2";
 filetime_t gb_st_start = 0; // start time of program
+int gb_decoder_jobs = 1; // # of files being decoded at the same time; threads are shared among them
+struct probe_pool *gb_probe_pool = NULL; // opens the next files of the batch; NULL = off
+int gb_decode_errors = 0; // # of packets decoders refused; decoders of files with errors aren't pooled
 
 /* misc functions */
 
@@ -382,91 +425,151 @@ int image_string_height(const char *text, const char *font, double size)
 }
 
 /*
-position can be:
-    1: lower left
-    2: lower right
-    3: upper right
-    4: upper left
+x, y of text with brect in a rect_width x rect_height rectangle & shadowx,
+shadowy of its shadow if shadow; see image_string_rect().
 returns NULL if success, otherwise returns error message
 */
-char *image_string(gdImagePtr ip, const char *font, uint32_t color, double size, int position, int gap, char *text, int shadow, uint32_t shadow_color, int padding)
+char *image_string_position(const int brect[8], int rect_width, int rect_height, int position, int gap, int padding,
+    int shadow, int *x, int *y, int *shadowx, int *shadowy)
 {
-    int brect[8];
-
-    int gd_color = gdImageColorResolve(ip, RGB_R(color), RGB_G(color), RGB_B(color));
-    char *err = gdImageStringFT(NULL, brect, gd_color, (char *) font, size, 0, 0, 0, (char *) text);
-
-    if (err)
-        return err;
-
-    int x, y;
     switch (position)
     {
     case 1: // lower left
-        x = -brect[0] + gap + padding;
-        y = gdImageSY(ip) - brect[1] - gap - padding;
+        *x = -brect[0] + gap + padding;
+        *y = rect_height - brect[1] - gap - padding;
         break;
     case 2: // lower right
-        x = gdImageSX(ip) - brect[2] - gap - padding;
-        y = gdImageSY(ip) - brect[3] - gap - padding;
+        *x = rect_width - brect[2] - gap - padding;
+        *y = rect_height - brect[3] - gap - padding;
         break;
     case 3: // upper right
-        x = gdImageSX(ip) - brect[4] - gap - padding;
-        y = -brect[5] + gap + padding + LIBGD_FONT_HEIGHT_CORRECTION;
+        *x = rect_width - brect[4] - gap - padding;
+        *y = -brect[5] + gap + padding + LIBGD_FONT_HEIGHT_CORRECTION;
         break;
     case 4: // upper left
-        x = -brect[6] + gap + padding;
-        y = -brect[7] + gap + padding + LIBGD_FONT_HEIGHT_CORRECTION;
+        *x = -brect[6] + gap + padding;
+        *y = -brect[7] + gap + padding + LIBGD_FONT_HEIGHT_CORRECTION;
         break;
     default:
         return "image_string's position can only be 1, 2, 3, or 4";
     }
+    if (!shadow)
+        return NULL;
+    switch (position)
+    {
+    case 1: // lower left
+        *shadowx = *x+1;
+        *shadowy = *y;
+        *y = *y-1;
+        break;
+    case 2: // lower right
+        *shadowx = *x;
+        *shadowy = *y;
+        *x = *x-1;
+        *y = *y-1;
+        break;
+    case 3: // upper right
+        *shadowx = *x;
+        *shadowy = *y+1;
+        *x = *x-1;
+        break;
+    case 4: // upper left
+        *shadowx = *x+1;
+        *shadowy = *y+1;
+        break;
+    }
+    return NULL;
+}
+
+/*
+position in the rect_width x rect_height rectangle at rect_x, rect_y of ip can be:
+    1: lower left
+    2: lower right
+    3: upper right
+    4: upper left
+the text is clipped to the rectangle.
+returns NULL if success, otherwise returns error message
+*/
+char *image_string_rect(gdImagePtr ip, int rect_x, int rect_y, int rect_width, int rect_height,
+    const char *font, uint32_t color, double size, int position, int gap, char *text, int shadow, uint32_t shadow_color, int padding)
+{
+    int brect[8];
+
+    int gd_color = gdImageColorResolve(ip, RGB_R(color), RGB_G(color), RGB_B(color));
+    char *err = gdImageStringFT(NULL, brect, gd_color, (char *) font, size, 0, 0, 0, (char *) text);
 
+    if (err)
+        return err;
+
+    int x, y, shadowx, shadowy;
+    err = image_string_position(brect, rect_width, rect_height, position, gap, padding, shadow, &x, &y, &shadowx, &shadowy);
+    if (err)
+        return err;
+
+    int cx1, cy1, cx2, cy2;
+    gdImageGetClip(ip, &cx1, &cy1, &cx2, &cy2);
+    gdImageSetClip(ip, MAX(rect_x, cx1), MAX(rect_y, cy1), MIN(rect_x + rect_width - 1, cx2), MIN(rect_y + rect_height - 1, cy2));
     if (shadow) {
-        int shadowx, shadowy;
-        switch (position)
-        {
-        case 1: // lower left
-            shadowx = x+1;
-            shadowy = y;
-            y = y-1;
-            break;
-        case 2: // lower right
-            shadowx = x;
-            shadowy = y;
-            x = x-1;
-            y = y-1;
-            break;
-        case 3: // upper right
-            shadowx = x;
-            shadowy = y+1;
-            x = x-1;
-            break;
-        case 4: // upper left
-            shadowx = x+1;
-            shadowy = y+1;
-            break;
-        default:
-            return "image_string's position can only be 1, 2, 3, or 4";
-        }
         int gd_shadow = gdImageColorResolve(ip, RGB_R(shadow_color), RGB_G(shadow_color), RGB_B(shadow_color));
-        err = gdImageStringFT(ip, brect, gd_shadow, (char *) font, size, 0, shadowx, shadowy, (char *) text);
-        if (err)
-            return err;
+        err = gdImageStringFT(ip, brect, gd_shadow, (char *) font, size, 0, rect_x + shadowx, rect_y + shadowy, (char *) text);
     }
 
-    return gdImageStringFT(ip, brect, gd_color, (char *) font, size, 0, x, y, (char *) text);
+    if (!err)
+        err = gdImageStringFT(ip, brect, gd_color, (char *) font, size, 0, rect_x + x, rect_y + y, (char *) text);
+    gdImageSetClip(ip, cx1, cy1, cx2, cy2);
+    return err;
+}
+
+/*
+image_string_rect() of a timestamp blitted from the glyphs of the open atlas
+ga; text with other characters & palette images go through freetype
+*/
+char *image_glyphs_rect(gdImagePtr ip, int rect_x, int rect_y, int rect_width, int rect_height,
+    const struct glyph_atlas *ga, uint32_t color, int position, int gap, char *text, int shadow, uint32_t shadow_color, int padding)
+{
+    int brect[8];
+
+    if (!gdImageTrueColor(ip) || glyph_atlas_brect(ga, text, brect))
+        return image_string_rect(ip, rect_x, rect_y, rect_width, rect_height,
+            ga->font, color, ga->size, position, gap, text, shadow, shadow_color, padding);
+
+    int x, y, shadowx, shadowy;
+    char *err = image_string_position(brect, rect_width, rect_height, position, gap, padding, shadow, &x, &y, &shadowx, &shadowy);
+    if (err)
+        return err;
+
+    int cx1, cy1, cx2, cy2;
+    gdImageGetClip(ip, &cx1, &cy1, &cx2, &cy2);
+    gdImageSetClip(ip, MAX(rect_x, cx1), MAX(rect_y, cy1), MIN(rect_x + rect_width - 1, cx2), MIN(rect_y + rect_height - 1, cy2));
+    if (shadow)
+        glyph_atlas_draw(ga, ip, rect_x + shadowx, rect_y + shadowy, shadow_color, text);
+    glyph_atlas_draw(ga, ip, rect_x + x, rect_y + y, color, text);
+    gdImageSetClip(ip, cx1, cy1, cx2, cy2);
+    return NULL;
+}
+
+/*
+image_string_rect() of the whole ip
+*/
+char *image_string(gdImagePtr ip, const char *font, uint32_t color, double size, int position, int gap, char *text, int shadow, uint32_t shadow_color, int padding)
+{
+    return image_string_rect(ip, 0, 0, gdImageSX(ip), gdImageSY(ip),
+        font, color, size, position, gap, text, shadow, shadow_color, padding);
 }
 
 /*
- * return 30% of character height as a padding
+ * return 30% of character height as a padding; measured once per font & size
  */
 int image_string_padding(const char *font, double size)
 {
-    int padding = (int) (image_string_height("SAMPLE", font, size) * 0.3 + 0.5);
-    if (padding > 1)
+    int padding;
+    if (render_cache_get_padding(font, size, &padding))
         return padding;
-    return 1;
+    padding = (int) (image_string_height("SAMPLE", font, size) * 0.3 + 0.5);
+    if (padding < 1)
+        padding = 1;
+    render_cache_put_padding(font, size, padding);
+    return padding;
 }
 
 /*
@@ -499,17 +602,13 @@ int save_image(gdImagePtr ip, const char *outname, const struct options *o)
 
 /*
 pFrame must be a AV_PIX_FMT_RGB24 frame
+ip must be a truecolor image of at least width x height
 */
-void FrameRGB_2_gdImage(AVFrame *pFrame, gdImagePtr ip, int width, int height)
+void FrameRGB_2_gdImage(const AVFrame *pFrame, gdImagePtr ip, int width, int height)
 {
-    uint8_t *src = pFrame->data[0];
-    int x, y;
+    int y;
     for (y = 0; y < height; y++)
-        for (x = 0; x < width; x++)
-        {
-            gdImageSetPixel(ip, x, y, gdImageColorResolve(ip, src[0], src[1], src[2]));
-            src += 3;
-        }
+        rgb24_to_truecolor_row(ip->tpixels[y], pFrame->data[0] + y * pFrame->linesize[0], width);
 }
 
 /* initialize 
@@ -692,6 +791,37 @@ int sprite_export_vtt(struct sprite *s)
     return result;
 }
 
+/*
+reload cues written by the previous run, so new cues are appended
+return 0 if ok
+*/
+int sprite_load_vtt(struct sprite *s)
+{
+    int filename_len = s->parent->base_filename.len;
+    char *outname = (char *) malloc(5 + filename_len);
+    memcpy(outname, s->parent->base_filename.s, filename_len);
+    strcpy(outname + filename_len, ".vtt");
+
+    int result = -1;
+    tchar_t *outname_w = utf8_to_tchar(outname);
+    FILE *fp = _tfopen(outname_w, TEXT_READ_MODE);
+    if (fp)
+    {
+        char buf[4096];
+        size_t n;
+        sb_clear(&s->vtt_content);
+        while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+            sb_add_string_len(&s->vtt_content, buf, (int) n);
+        if (!ferror(fp) && s->vtt_content.len)
+            result = 0;
+        fclose(fp);
+    }
+
+    free_conv_result(outname_w);
+    free(outname);
+    return result;
+}
+
 void sprite_destroy(struct sprite *s)
 {
     if (!s) return;
@@ -779,24 +909,239 @@ gdImagePtr create_shadow_image(int background, int width, int height, int *radiu
     return NULL;
 }
 
+/*
+create_shadow_image() or the one of a previous file with the same size,
+radius & background. *key is set for giving it back to the render cache
+*/
+gdImagePtr get_shadow_image(int background, int width, int height, int *radius_inout, struct shadow_key *key,
+    const struct options *o)
+{
+    key->background = background;
+    key->width = width;
+    key->height = height;
+    key->radius = *radius_inout;
+    gdImagePtr shadow = render_cache_get_shadow(key, radius_inout);
+    if (!shadow)
+        shadow = create_shadow_image(background, width, height, radius_inout, o);
+    return shadow;
+}
+
 /* 
 add shot
 because ptn->idx is the last index, this function assumes that shots will be added 
 in increasing order.
 */
-void thumb_add_shot(struct thumbnail *ptn, gdImagePtr ip, gdImagePtr thumbShadowIm, int shadow_pos, int idx, int64_t pts, const struct options *o)
+void thumb_shot_position(const struct thumbnail *ptn, int idx, int *x, int *y, const struct options *o)
 {
-    int dstX = idx%ptn->column * (ptn->shot_width_out+o->g_gap) + o->g_gap + ptn->center_gap;
-    int dstY = idx/ptn->column * (ptn->shot_height_out+o->g_gap) + o->g_gap
+    *x = idx%ptn->column * (ptn->shot_width_out+o->g_gap) + o->g_gap + ptn->center_gap;
+    *y = idx/ptn->column * (ptn->shot_height_out+o->g_gap) + o->g_gap
         + ((o->L_info_location == 3 || o->L_info_location == 4) ? ptn->txt_height : 0);
+}
+
+/*
+gdImageCopy() of width x height pixels of src at 0, 0 to dst at dst_x, dst_y.
+opaque truecolor pixels just replace the ones below them, so rows of them
+are copied with memcpy()
+*/
+void image_copy_rows(gdImagePtr dst, gdImagePtr src, int dst_x, int dst_y, int width, int height)
+{
+    int cx1, cy1, cx2, cy2, x, y;
+    if (!dst->trueColor || !src->trueColor || src->transparent >= 0)
+    {
+        gdImageCopy(dst, src, dst_x, dst_y, 0, 0, width, height);
+        return;
+    }
+    gdImageGetClip(dst, &cx1, &cy1, &cx2, &cy2);
+    int x_begin = MAX(dst_x, cx1);
+    int x_end = MIN(dst_x + MIN(width, gdImageSX(src)) - 1, cx2);
+    int y_end = MIN(dst_y + MIN(height, gdImageSY(src)) - 1, cy2);
+    int n = x_end - x_begin + 1;
+    for (y = MAX(dst_y, cy1); y <= y_end && n > 0; y++)
+    {
+        const int *s = src->tpixels[y - dst_y] + x_begin - dst_x;
+        int *d = dst->tpixels[y] + x_begin;
+        int alpha = 0;
+        for (x = 0; x < n; x++)
+            alpha |= s[x];
+        if (gdTrueColorGetAlpha(alpha) == gdAlphaOpaque)
+            memcpy(d, s, n * sizeof(int));
+        else
+            for (x = 0; x < n; x++)
+                gdImageSetPixel(dst, x_begin + x, y, s[x]);
+    }
+}
+
+void thumb_add_shot(struct thumbnail *ptn, gdImagePtr ip, gdImagePtr thumbShadowIm, int shadow_pos, int idx, int64_t pts, const struct options *o)
+{
+    int dstX, dstY;
+    thumb_shot_position(ptn, idx, &dstX, &dstY, o);
+
+    if (thumbShadowIm)
+        image_copy_rows(ptn->out_ip, thumbShadowIm, dstX+shadow_pos+1, dstY+shadow_pos+1, gdImageSX(thumbShadowIm), gdImageSY(thumbShadowIm));
+
+    image_copy_rows(ptn->out_ip, ip, dstX, dstY, ptn->shot_width_out, ptn->shot_height_out);
+    ptn->idx = idx;
+    ptn->ppts[idx] = pts;
+    ptn->tiles_nr++;
+}
+
+/*
+return distance (in pixels) between the rows of ip if they are equally
+spaced in memory, so a shot can be scaled straight into them; 0 if not
+*/
+int canvas_stride(gdImagePtr ip)
+{
+    int y, sy = gdImageSY(ip);
+    if (sy < 2)
+        return gdImageSX(ip);
+    ptrdiff_t stride = ip->tpixels[1] - ip->tpixels[0];
+    if (stride < gdImageSX(ip) || stride > INT_MAX / (int) sizeof(int))
+        return 0;
+    for (y = 2; y < sy; y++)
+        if (ip->tpixels[y] - ip->tpixels[y-1] != stride)
+            return 0;
+    return (int) stride;
+}
+
+void tile_scaler_init(struct tile_scaler *ts)
+{
+    ts->pSwsCtx = NULL;
+    ts->frame = NULL;
+    ts->rows = NULL;
+    ts->stride = 0;
+}
+
+void tile_scaler_free(struct tile_scaler *ts)
+{
+    av_frame_free(&ts->frame);
+    free(ts->rows);
+    tile_scaler_init(ts);
+}
+
+/*
+prepare scaling of src_width x src_height src_fmt frames into the tiles of ptn->out_ip.
+return 0 if ok
+*/
+int tile_scaler_open(struct tile_scaler *ts, const struct thumbnail *ptn, int src_width, int src_height,
+    enum AVPixelFormat src_fmt, int sws_flags)
+{
+    int y;
+    ts->pSwsCtx = decoder_pool_get_sws(src_width, src_height, src_fmt,
+        ptn->shot_width_in, ptn->shot_height_in, AV_PIX_FMT_0RGB32, sws_flags);
+    ts->frame = av_frame_alloc();
+    ts->rows = malloc(ptn->shot_height_in * sizeof(*ts->rows));
+    if (!ts->pSwsCtx || !ts->frame || !ts->rows)
+        return -1;
+    ts->frame->width = ptn->shot_width_in;
+    ts->frame->height = ptn->shot_height_in;
+    ts->frame->format = AV_PIX_FMT_0RGB32;
+    if (av_frame_get_buffer(ts->frame, 32) < 0)
+        return -1;
+    for (y = 0; y < ptn->shot_height_in; y++)
+        ts->rows[y] = (int *) (ts->frame->data[0] + y * ts->frame->linesize[0]);
+    ts->stride = canvas_stride(ptn->out_ip);
+    return 0;
+}
+
+/*
+scale pFrame into its tile of ptn->out_ip. gd truecolor pixels are
+native-endian 0x00RRGGBB ints, i.e. AV_PIX_FMT_0RGB32 with the alpha bits
+cleared, so swscale writes the tile's rows directly when they are equally
+spaced & aligned. otherwise, or when the movie is rotated, it scales into ts->frame & the
+rows are copied (rotated) into the tile.
+return 0 if ok, 1 if the tile isn't inside out_ip, -1 on error
+*/
+int thumb_scale_shot(struct thumbnail *ptn, struct tile_scaler *ts, const AVFrame *pFrame, int src_height,
+    gdImagePtr thumbShadowIm, int shadow_pos, int idx, int64_t pts, const struct options *o)
+{
+    int dstX, dstY;
+    thumb_shot_position(ptn, idx, &dstX, &dstY, o);
+    if (dstX < 0 || dstY < 0 || dstX + ptn->shot_width_out > gdImageSX(ptn->out_ip)
+        || dstY + ptn->shot_height_out > gdImageSY(ptn->out_ip))
+        return 1;
 
     if (thumbShadowIm)
-        gdImageCopy(ptn->out_ip, thumbShadowIm, dstX+shadow_pos+1, dstY+shadow_pos+1, 0, 0, gdImageSX(thumbShadowIm), gdImageSY(thumbShadowIm));
+        image_copy_rows(ptn->out_ip, thumbShadowIm, dstX+shadow_pos+1, dstY+shadow_pos+1, gdImageSX(thumbShadowIm), gdImageSY(thumbShadowIm));
+
+    uint8_t *dst[4] = { (uint8_t *) (ptn->out_ip->tpixels[dstY] + dstX), NULL, NULL, NULL };
+    int dst_linesize[4] = { ts->stride * (int) sizeof(int), 0, 0, 0 };
+    // swscale is slower (& says so) with unaligned output
+    int direct = ts->stride && !ptn->rotation && !(((uintptr_t) dst[0] | (uintptr_t) dst_linesize[0]) & 15);
+    if (!direct)
+    {
+        dst[0] = ts->frame->data[0];
+        dst_linesize[0] = ts->frame->linesize[0];
+    }
+    if (sws_scale(ts->pSwsCtx, (const uint8_t * const *) pFrame->data, pFrame->linesize, 0, src_height,
+            dst, dst_linesize) <= 0)
+        return -1;
+    // before rotating; rotated tiles are shot_width_out wide
+    if (direct)
+        opaque_pixels(ptn->out_ip->tpixels + dstY, dstX, ptn->shot_width_in, ptn->shot_height_in);
+    else
+        opaque_pixels(ts->rows, 0, ptn->shot_width_in, ptn->shot_height_in);
+    if (!direct && rotate_pixels(ptn->out_ip->tpixels + dstY, dstX, (const int * const *) ts->rows,
+            ptn->shot_width_in, ptn->shot_height_in, ptn->rotation))
+        return -1;
 
-    gdImageCopy(ptn->out_ip, ip, dstX, dstY, 0, 0, ptn->shot_width_out, ptn->shot_height_out);
     ptn->idx = idx;
     ptn->ppts[idx] = pts;
     ptn->tiles_nr++;
+    return 0;
+}
+
+void gray_shot_init(struct gray_shot *gs)
+{
+    gs->pSwsCtx = NULL;
+    gs->luma_plane = 0;
+    gs->data = NULL;
+    gs->width = gs->height = 0;
+}
+
+void gray_shot_free(struct gray_shot *gs)
+{
+    av_free(gs->data);
+    gray_shot_init(gs);
+}
+
+/*
+prepare scaling of src_width x src_height src_fmt frames to width x height
+gray shots. when luma is an 8-bit plane of its own (yuv420p, nv12, ...),
+only that plane is scaled; other formats (rgb, 10-bit) are converted.
+return 0 if ok
+*/
+int gray_shot_open(struct gray_shot *gs, int src_width, int src_height, enum AVPixelFormat src_fmt,
+    int width, int height, int sws_flags)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(src_fmt);
+    gs->luma_plane = desc && !(desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM))
+        && desc->comp[0].plane == 0 && desc->comp[0].step == 1 && desc->comp[0].depth == 8 && !desc->comp[0].shift;
+    gs->data = av_malloc(width * height);
+    if (!gs->data)
+        return -1;
+    gs->width = width;
+    gs->height = height;
+    gs->pSwsCtx = decoder_pool_get_sws(src_width, src_height, gs->luma_plane ? AV_PIX_FMT_GRAY8 : src_fmt,
+        width, height, AV_PIX_FMT_GRAY8, sws_flags);
+    return gs->pSwsCtx ? 0 : -1;
+}
+
+/*
+scale pFrame into gs->data.
+return 0 if ok
+*/
+int gray_shot_scale(struct gray_shot *gs, const AVFrame *pFrame, int src_height)
+{
+    const uint8_t *src[4] = { pFrame->data[0], NULL, NULL, NULL };
+    int src_linesize[4] = { pFrame->linesize[0], 0, 0, 0 };
+    if (!gs->luma_plane)
+    {
+        memcpy(src, pFrame->data, sizeof(src));
+        memcpy(src_linesize, pFrame->linesize, sizeof(src_linesize));
+    }
+    uint8_t *dst[4] = { gs->data, NULL, NULL, NULL };
+    int dst_linesize[4] = { gs->width, 0, 0, 0 };
+    return sws_scale(gs->pSwsCtx, src, src_linesize, 0, src_height, dst, dst_linesize) > 0 ? 0 : -1;
 }
 
 /*
@@ -844,8 +1189,7 @@ void FrameRGB_convolution(AVFrame *pFrame, int width, int height,
             new_b = (new_b > 255.0f)? 255.0f : ((new_b < 0.0f)? 0.0f:new_b);
             //grey = (grey > 255.0f)? 255.0f : ((grey < 0.0f)? 0.0f:grey);
 
-            gdImageSetPixel(ip, x, y, gdImageColorResolve(ip, (int)new_r, (int)new_g, (int)new_b));
-            //gdImageSetPixel(ip, x, y, gdTrueColor((int)new_r, (int)new_g, (int)new_b));
+            ip->tpixels[y][x] = gdTrueColor((int)new_r, (int)new_g, (int)new_b); // ip is truecolor
             //gdImageSetPixel(ip, x, y, gdTrueColor((int)grey, (int)grey, (int)grey));
         }
     }
@@ -885,6 +1229,30 @@ int is_edge(const double *edge, double edge_found)
     return 0;
 }
 
+/*
+parts of a width x height shot checked for edges; xbegin, ybegin, xend, yend
+*/
+void edge_parts(int width, int height, int parts[EDGE_PARTS][4])
+{
+    // check 6 parts to speed this up & to improve correctness
+    int y_size = height/10;
+    int ya = y_size*2;
+    int yb = y_size*4;
+    int yc = y_size*6;
+    int x_crop = width/8;
+    int part[EDGE_PARTS][4] =
+    {
+        //xbegin, ybegin, xend, yend
+        {x_crop, ya, width/2, ya+y_size},
+        {width/2+1, ya+y_size, width-x_crop, ya+2*y_size},
+        {x_crop, yb, width/2, yb+y_size},
+        {width/2+1, yb+y_size, width-x_crop, yb+2*y_size},
+        {x_crop, yc, width/2, yc+y_size},
+        {width/2+1, yc+y_size, width-x_crop, yc+2*y_size},
+    };
+    memcpy(parts, part, sizeof(part));
+}
+
 /*
 pFrame must be an AV_PIX_FMT_RGB24 frame
 http://student.kuleuven.be/~m0216922/CG/
@@ -929,24 +1297,9 @@ gdImagePtr detect_edge(AVFrame *pFrame, const struct thumbnail* const tn, double
     for (i = 0; i < EDGE_PARTS; i++)
         edge[i] = 1;
 
-    // check 6 parts to speed this up & to improve correctness
-    int y_size = height/10;
-    int ya = y_size*2;
-    int yb = y_size*4;
-    int yc = y_size*6;
-    int x_crop = width/8;
-
     // only find edge if neccessary
-    int parts[EDGE_PARTS][4] =
-    {
-        //xbegin, ybegin, xend, yend
-        {x_crop, ya, width/2, ya+y_size},
-        {width/2+1, ya+y_size, width-x_crop, ya+2*y_size},
-        {x_crop, yb, width/2, yb+y_size},
-        {width/2+1, yb+y_size, width-x_crop, yb+2*y_size},
-        {x_crop, yc, width/2, yc+y_size},
-        {width/2+1, yc+y_size, width-x_crop, yc+2*y_size},
-    };
+    int parts[EDGE_PARTS][4];
+    edge_parts(width, height, parts);
     int count = 0;
     for (i = 0; i < EDGE_PARTS && count < 2; i++)
     {
@@ -959,6 +1312,35 @@ gdImagePtr detect_edge(AVFrame *pFrame, const struct thumbnail* const tn, double
     return ip;
 }
 
+/*
+detect_edge() on a gray8 shot, without an image of the edges.
+o->D_edge * (4 * pixel - its 4 neighbors) / 4 + OFFSET >= CMP_EDGE is
+counted in integers; o->D_edge must be > 0
+*/
+void detect_edge_gray(const uint8_t *src, int width, int height, double *edge, double edge_found, const struct options *o)
+{
+    int threshold = (4 * (CMP_EDGE - OFFSET) + o->D_edge - 1) / o->D_edge;
+    int parts[EDGE_PARTS][4];
+    int i, y, count = 0;
+    for (i = 0; i < EDGE_PARTS; i++)
+        edge[i] = 1;
+    edge_parts(width, height, parts);
+    for (i = 0; i < EDGE_PARTS && count < 2; i++)
+    {
+        int bright = 0;
+        for (y = parts[i][1]; y <= parts[i][3]; y++)
+        {
+            const uint8_t *up = src + MAX(y - 1, 0) * width;
+            const uint8_t *row = src + y * width;
+            const uint8_t *down = src + MIN(y + 1, height - 1) * width;
+            bright += count_edges(up, row, down, width, parts[i][0], MIN(parts[i][2], width - 1), threshold);
+        }
+        edge[i] = (double) bright / ((parts[i][3] - parts[i][1] + 1) * (parts[i][2] - parts[i][0] + 1));
+        if (edge[i] >= edge_found)
+            count++;
+    }
+}
+
 int
 save_AVFrame(
     const AVFrame* const pFrame,
@@ -998,7 +1380,7 @@ save_AVFrame(
         av_image_fill_arrays(scaled_frame->data, scaled_frame->linesize, rgb_buffer, rgb_pix_fmt, dst_width, dst_height, LINESIZE_ALIGN);
 
         pSwsCtx = sws_getContext(src_width, src_height, pix_fmt,
-            dst_width, dst_height, rgb_pix_fmt, SWS_BILINEAR, NULL, NULL, NULL);
+            dst_width, dst_height, rgb_pix_fmt, o->sws_flags, NULL, NULL, NULL);
         if (!pSwsCtx)
         {
             av_log(NULL, AV_LOG_ERROR, "  sws_getContext failed\n");
@@ -1040,24 +1422,105 @@ cleanup:
 
 
 
-/* av_pkt_dump_log()?? */
-void dump_packet(AVPacket *p, AVStream * ps)
+/*
+return 1 if jpeg data has its own huffman tables (DHT before SOS)
+*/
+int jpeg_has_dht(const uint8_t *data, int size)
 {
-    /* from av_read_frame()
-    pkt->pts, pkt->dts and pkt->duration are always set to correct values in 
-    AVStream.timebase units (and guessed if the format cannot provided them). 
-    pkt->pts can be AV_NOPTS_VALUE if the video format has B frames, so it is 
-    better to rely on pkt->dts if you do not decompress the payload.
-    */
-    av_log(NULL, AV_LOG_VERBOSE, "***dump_packet: pos:%"PRId64"\n", p->pos);
-    av_log(NULL, AV_LOG_VERBOSE, "pts tb: %"PRId64", dts tb: %"PRId64", duration tb: %"PRId64"\n",
-        p->pts, p->dts, p->duration);
-    av_log(NULL, AV_LOG_VERBOSE, "pts s: %.2f, dts s: %.2f, duration s: %.2f\n",
-        p->pts * av_q2d(ps->time_base), p->dts * av_q2d(ps->time_base), 
-        p->duration * av_q2d(ps->time_base)); // pts can be AV_NOPTS_VALUE
+    int i = 2; // skip SOI
+    while (i + 4 <= size && data[i] == 0xFF)
+    {
+        int marker = data[i+1];
+        if (marker == 0xC4) // DHT
+            return 1;
+        if (marker == 0xDA) // SOS
+            return 0;
+        i += 2 + (data[i+2] << 8 | data[i+3]);
+    }
+    return 0;
 }
 
-void dump_codec_context(AVCodecContext * p)
+/*
+write packet of an intra-only stream to an image file as it is, without
+decoding & encoding again. MJPEG packets (e.g. in .avi) usually omit the
+standard huffman tables, they're inserted by mjpeg2jpeg bitstream filter.
+return 0 if saved
+*/
+int save_packet_image(const AVPacket *pkt, const AVCodecParameters *par, const char *filename)
+{
+    AVPacket *out = NULL;
+    AVBSFContext *bsf = NULL;
+    const uint8_t *data = pkt->data;
+    int size = pkt->size;
+    int result = -1;
+
+    if (par->codec_id == AV_CODEC_ID_MJPEG)
+    {
+        if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) // SOI
+            return -1;
+        if (!jpeg_has_dht(data, size))
+        {
+            const AVBitStreamFilter *filter = av_bsf_get_by_name("mjpeg2jpeg");
+            out = av_packet_alloc();
+            if (!filter || !out
+                || av_bsf_alloc(filter, &bsf) < 0
+                || avcodec_parameters_copy(bsf->par_in, par) < 0
+                || av_bsf_init(bsf) < 0
+                || av_packet_ref(out, pkt) < 0
+                || av_bsf_send_packet(bsf, out) < 0
+                || av_bsf_receive_packet(bsf, out) < 0)
+                goto cleanup;
+            data = out->data;
+            size = out->size;
+        }
+    }
+    else if (par->codec_id == AV_CODEC_ID_PNG)
+    {
+        if (size < 8 || memcmp(data, "\x89PNG", 4))
+            return -1;
+    }
+    else
+        return -1;
+
+    const tchar_t *tname = utf8_to_tchar(filename);
+    FILE *fp = _tfopen(tname, BINARY_WRITE_MODE);
+    free_conv_result(tname);
+    if (fp)
+    {
+        if (fwrite(data, 1, size, fp) == (size_t) size)
+            result = 0;
+        if (fclose(fp))
+            result = -1;
+        if (result)
+            av_log(NULL, AV_LOG_ERROR, "\n%s: writing image '%s' failed: %s\n", gb_argv0, filename, strerror(errno));
+    }
+    else
+        av_log(NULL, AV_LOG_ERROR, "\n%s: creating output image '%s' failed: %s\n", gb_argv0, filename, strerror(errno));
+
+  cleanup:
+    av_bsf_free(&bsf);
+    av_packet_free(&out);
+    return result;
+}
+
+/* av_pkt_dump_log()?? */
+void dump_packet(AVPacket *p, AVStream * ps)
+{
+    /* from av_read_frame()
+    pkt->pts, pkt->dts and pkt->duration are always set to correct values in 
+    AVStream.timebase units (and guessed if the format cannot provided them). 
+    pkt->pts can be AV_NOPTS_VALUE if the video format has B frames, so it is 
+    better to rely on pkt->dts if you do not decompress the payload.
+    */
+    av_log(NULL, AV_LOG_VERBOSE, "***dump_packet: pos:%"PRId64"\n", p->pos);
+    av_log(NULL, AV_LOG_VERBOSE, "pts tb: %"PRId64", dts tb: %"PRId64", duration tb: %"PRId64"\n",
+        p->pts, p->dts, p->duration);
+    av_log(NULL, AV_LOG_VERBOSE, "pts s: %.2f, dts s: %.2f, duration s: %.2f\n",
+        p->pts * av_q2d(ps->time_base), p->dts * av_q2d(ps->time_base), 
+        p->duration * av_q2d(ps->time_base)); // pts can be AV_NOPTS_VALUE
+}
+
+void dump_codec_context(AVCodecContext * p)
 {
     if(p->codec == 0)
         av_log(NULL, AV_LOG_VERBOSE, "***dump_codec_context: codec = ?0?\n");
@@ -1183,6 +1646,50 @@ AVCodecContext* get_codecContext_from_codecParams(AVCodecParameters* pCodecPar)
     return pCodecContext;
 }
 
+/*
+choose thread_type & thread_count before the decoder is opened.
+frame threads delay output by thread_count frames & are flushed on every
+seek, so they only pay off when shots are close enough to be reached by
+decoding forward, or when the whole input is decoded in a single pass
+(single_pass, e.g. pipes). slice threads don't add latency but not all
+codecs have them. a cpu is left to each thread probing the next files &
+the rest is split among files decoded at the same time.
+*/
+void set_decoder_threading(AVCodecContext *pCodecCtx, const AVCodec *pCodec, int nb_shots, double duration,
+    int single_pass, const struct options *o)
+{
+    int cpus = MAX(av_cpu_count() - probe_pool_nb_threads(gb_probe_pool), 1);
+    int threads = MAX(cpus / MAX(gb_decoder_jobs, 1), 1);
+    int64_t pixels = (int64_t) pCodecCtx->width * pCodecCtx->height;
+    if (pixels <= 720*576) // SD doesn't scale over many threads
+        threads = MIN(threads, 2);
+    else if (pixels <= 1920*1088)
+        threads = MIN(threads, 8);
+
+    // usually movies have key frames every 10 s
+    double shot_distance = nb_shots > 0 && duration > 0 ? duration / nb_shots : 0;
+    int sequential = single_pass || o->Z_nonseek || o->s_step < 0 || (shot_distance > 0 && shot_distance < 10);
+
+    int can_frame = pCodec->capabilities & AV_CODEC_CAP_FRAME_THREADS;
+    int can_slice = pCodec->capabilities & AV_CODEC_CAP_SLICE_THREADS;
+    if (sequential && can_frame)
+        pCodecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    else if (can_slice)
+        pCodecCtx->thread_type = FF_THREAD_SLICE;
+    else if (can_frame)
+    {
+        pCodecCtx->thread_type = FF_THREAD_FRAME;
+        threads = MIN(threads, 2); // keep flushing cheap
+    }
+    else
+        threads = 1;
+    pCodecCtx->thread_count = threads;
+
+    av_log(NULL, AV_LOG_VERBOSE, "  decoder threads: %d, type: %s%s\n", threads,
+        pCodecCtx->thread_type & FF_THREAD_FRAME ? "frame " : "",
+        pCodecCtx->thread_type & FF_THREAD_SLICE ? "slice" : "");
+}
+
 /*
 modified from libavformat's dump_format
 */
@@ -1344,7 +1851,7 @@ void get_stream_info(struct string_buffer *sb, const AVFormatContext *ic, const
     if (strip_path)
         file_name = basename(url);
 
-    int64_t file_size = avio_size(ic->pb);
+    int64_t file_size = ic->pb ? avio_size(ic->pb) : -1; // unknown for pipes
 
     sb_add_string(sb, "File: ");
     sb_add_string(sb, file_name);
@@ -1355,7 +1862,9 @@ void get_stream_info(struct string_buffer *sb, const AVFormatContext *ic, const
 
     format_size(file_size, size_buf, sizeof(size_buf));
     int len;
-    if (o->H_human_filesize)
+    if (file_size < 0)
+        len = sprintf(tmp_buf, "\nSize: N/A");
+    else if (o->H_human_filesize)
         /* File size only in MiB, GiB, ... */
         len = sprintf(tmp_buf, "\nSize: %s", size_buf);
     else
@@ -1392,7 +1901,7 @@ void get_stream_info(struct string_buffer *sb, const AVFormatContext *ic, const
 
     if (ic->bit_rate)
         sb_add_string_len(sb, tmp_buf, sprintf(tmp_buf, ", bitrate: %"PRId64" kb/s", ic->bit_rate / 1000));
-    else if (duration > 0)
+    else if (duration > 0 && file_size > 0)
         sb_add_string_len(sb, tmp_buf, sprintf(tmp_buf, ", avg.bitrate: %.0f kb/s", (double) file_size * 8.0 / duration / 1000));
     else
         sb_add_string(sb, ", bitrate: N/A");
@@ -1450,30 +1959,18 @@ void dump_format_context(AVFormatContext *p, int index, const char *url, const s
 
 double uint8_cmp(const uint8_t *pa, const uint8_t *pb, const uint8_t *pc, int n)
 {
-    int i, same = 0;
-    for (i = 0; i < n; i++)
-    {
-        int diffab = pa[i] - pb[i];
-        int diffac = pa[i] - pc[i];
-        int diffbc = pb[i] - pc[i];
-
-        if (abs(diffab) < 20 && abs(diffac) < 20 && abs(diffbc) < 20)
-            same++;
-    }
-    return (double)same / n;
+    return (double)count_same_bytes(pa, pb, pc, n) / n;
 }
 
 /*
-return sameness of the frame; 1 means the frame is the same in all directions, i.e. blank
-pFrame must be an AV_PIX_FMT_RGB24 frame
+return sameness of height rows of row_size bytes at src; 1 means the picture is the same in all directions, i.e. blank
 */
-double blank_frame(AVFrame *pFrame, int width, int height)
+double blank_plane(const uint8_t *src, int row_size, int height)
 {
-    uint8_t *src = pFrame->data[0];
-    int hor_size = height/11 * width * 3;
-    uint8_t *pa = src+hor_size*2;
-    uint8_t *pb = src+hor_size*5;
-    uint8_t *pc = src+hor_size*8;
+    int hor_size = height/11 * row_size;
+    const uint8_t *pa = src+hor_size*2;
+    const uint8_t *pb = src+hor_size*5;
+    const uint8_t *pc = src+hor_size*8;
     double same = .4*uint8_cmp(pa, pb, pc, hor_size);
     int ver_size = hor_size/3;
     same += .6/3*uint8_cmp(pa, pa + ver_size, pa + ver_size*2, ver_size);
@@ -1482,8 +1979,19 @@ double blank_frame(AVFrame *pFrame, int width, int height)
     return same;
 }
 
+/*
+pFrame must be an AV_PIX_FMT_RGB24 frame
+*/
+double blank_frame(AVFrame *pFrame, int width, int height)
+{
+    return blank_plane(pFrame->data[0], width * 3, height);
+}
+
 /* global */
 uint64_t gb_video_pkt_pts = AV_NOPTS_VALUE;
+AVPacket *gb_video_pkt = NULL; // if allocated, holds the packet of the last decoded frame
+struct archive gb_archive = { 0, NULL }; // members of the last archive inputs were read from
+char *gb_archive_file = NULL;
 
 
 /**
@@ -1511,7 +2019,10 @@ int get_frame_from_packet(AVCodecContext *pCodecCtx,
     if(fret == AVERROR_INVALIDDATA ||
        fret == -1 /* Operation not permitted */
     )
+    {
+        gb_decode_errors++;
         return AVERROR(EAGAIN);
+    }
     
     if (fret < 0)
     {
@@ -1635,6 +2146,12 @@ video_decode_next_frame(AVFormatContext *pFormatCtx,
 
             av_log(NULL, AV_LOG_VERBOSE, "*get_videoframe got frame: key_frame: %d, pict_type: %c\n", pFrame->key_frame, av_get_picture_type_char(pFrame->pict_type));
 
+            if (gb_video_pkt)
+            {
+                av_packet_unref(gb_video_pkt);
+                av_packet_ref(gb_video_pkt, pkt);
+            }
+
             if (decoded_frame % 200 == 0)
                 av_log(NULL, AV_LOG_INFO, "  picture not decoded in %d frames\n", decoded_frame);
             break;
@@ -1795,6 +2312,139 @@ int really_seek(AVFormatContext *pFormatCtx, int index, int64_t timestamp, doubl
     return -1;
 }
 
+/*
+candidate shots of a non-seekable input collected in a single pass.
+candidate k is the first frame at or after origin + (k+1) * interval.
+when all slots are used, every other candidate is dropped and interval
+is doubled, so memory stays bounded regardless of the stream's length.
+*/
+struct reservoir
+{
+    int capacity;
+    int count;
+    int64_t origin;   // in time_base unit
+    int64_t interval; // in time_base unit
+    int64_t *pts;
+    uint8_t **rgb;    // AV_PIX_FMT_RGB24 shots
+};
+
+void reservoir_init(struct reservoir *r)
+{
+    memset(r, 0, sizeof(*r));
+}
+
+/*
+return -1 if failed
+*/
+int reservoir_alloc(struct reservoir *r, int capacity, int rgb_bufsize)
+{
+    int i;
+    r->pts = malloc(capacity * sizeof(*r->pts));
+    r->rgb = calloc(capacity, sizeof(*r->rgb));
+    if (!r->pts || !r->rgb)
+        return -1;
+    r->capacity = capacity;
+    for (i = 0; i < capacity; i++)
+        if (!(r->rgb[i] = av_malloc(rgb_bufsize)))
+            return -1;
+    return 0;
+}
+
+void reservoir_decimate(struct reservoir *r)
+{
+    // keep odd candidates, i.e. the ones on the doubled interval;
+    // buffers are swapped so they can be reused
+    int i;
+    for (i = 0; 2*i+1 < r->count; i++)
+    {
+        uint8_t *tmp = r->rgb[i];
+        r->rgb[i] = r->rgb[2*i+1];
+        r->rgb[2*i+1] = tmp;
+        r->pts[i] = r->pts[2*i+1];
+    }
+    r->count = i;
+    r->interval *= 2;
+}
+
+/*
+return index of the candidate for shot idx out of nb evenly spaced shots
+*/
+int reservoir_pick(const struct reservoir *r, int idx, int nb)
+{
+    if (nb >= r->count)
+        return idx;
+    return (int) ((idx + 0.5) * r->count / nb);
+}
+
+void reservoir_free(struct reservoir *r)
+{
+    int i;
+    if (r->rgb)
+        for (i = 0; i < r->capacity; i++)
+            av_free(r->rgb[i]);
+    free(r->rgb);
+    free(r->pts);
+    reservoir_init(r);
+}
+
+/*
+decode the whole input once and collect candidates into reservoir r
+return # of candidates
+*/
+int stream_collect(AVFormatContext *pFormatCtx, AVCodecContext *pCodecCtx, AVFrame *pFrame, int video_index,
+    struct SwsContext *pSwsCtx, struct pyramid *pyr, struct gray_shot *gray, AVFrame *pFrameRGB, int evade,
+    const struct thumbnail *tn, struct reservoir *r, const struct options *o)
+{
+    int64_t end_pts = o->C_cut > 0 ? r->origin + (int64_t) (o->C_cut / tn->time_base) : INT64_MAX;
+    int64_t pts;
+    while (video_decode_next_frame(pFormatCtx, pCodecCtx, pFrame, video_index, &pts) > 0)
+    {
+        if (pts == AV_NOPTS_VALUE)
+            continue;
+        if (pts > end_pts)
+            break;
+        int64_t target = r->origin + (r->count + 1) * r->interval;
+        if (pts < target)
+            continue;
+
+        const AVFrame *pScaleFrame = pyramid_reduce(pyr, pFrame);
+        // try following frames for half of the interval if blank
+        int try_next = evade && pts < target + r->interval / 2;
+        if (try_next && gray->pSwsCtx)
+        {
+            // on the luma, so blank frames aren't converted to rgb
+            if (gray_shot_scale(gray, pScaleFrame, pyr->height))
+            {
+                av_log(NULL, AV_LOG_ERROR, "  sws_scale() failed\n");
+                break;
+            }
+            if (blank_plane(gray->data, gray->width, gray->height) > o->b_blank)
+                continue;
+            try_next = 0;
+        }
+
+        av_image_fill_arrays(pFrameRGB->data, pFrameRGB->linesize, r->rgb[r->count], AV_PIX_FMT_RGB24, tn->shot_width_in, tn->shot_height_in, LINESIZE_ALIGN);
+        if (sws_scale(pSwsCtx, (const uint8_t* const*)pScaleFrame->data, pScaleFrame->linesize, 0, pyr->height,
+            pFrameRGB->data, pFrameRGB->linesize) <= 0)
+        {
+            av_log(NULL, AV_LOG_ERROR, "  sws_scale() failed\n");
+            break;
+        }
+
+        if (try_next && blank_frame(pFrameRGB, tn->shot_width_in, tn->shot_height_in) > o->b_blank)
+            continue;
+
+        r->pts[r->count++] = pts;
+        if (r->count == r->capacity)
+        {
+            reservoir_decimate(r);
+            av_log(NULL, AV_LOG_VERBOSE, "  reservoir full at %.2f s; interval: %.2f s\n",
+                pts * tn->time_base, r->interval * tn->time_base);
+        }
+    }
+    return r->count;
+}
+
 #if 0
 /* 
 modify name so that it'll (hopefully) be unique
@@ -1870,7 +2520,7 @@ find_default_videostream_index(AVFormatContext *s, int user_selected_video_strea
 
 gdImagePtr rotate_gdImage(gdImagePtr ip, int angle)
 {
-    if(angle == 0)
+    if(angle == 0 || !ip)
         return ip;
     
     int win = gdImageSX(ip);
@@ -1884,28 +2534,16 @@ gdImagePtr rotate_gdImage(gdImagePtr ip, int angle)
     }
 
     gdImagePtr ipr = gdImageCreateTrueColor(wout, hout);
+    if (!ipr)
+        return ip;
 
-    int i,j;
+    // ip comes from gdImageCreateTrueColor() too
+    if (rotate_pixels(ipr->tpixels, 0, (const int * const *) ip->tpixels, win, hin, angle))
+    {
+        gdImageDestroy(ipr);
+        return ip;
+    }
 
-    for(i=0; i<win; i++)
-        for(j=0; j<hin; j++)
-            switch(angle)
-            {
-                case -180:
-                case +180:
-                    gdImageSetPixel(ipr, wout-i, hout-j, gdImageGetPixel(ip, i, j));
-                    break;
-                case   90:
-                    gdImageSetPixel(ipr, j,      hout-i, gdImageGetPixel(ip, i, j));
-                    break;
-                case  -90:
-                    gdImageSetPixel(ipr, wout-j, i,      gdImageGetPixel(ip, i, j));
-                    break;
-                default:
-                    gdImageDestroy(ipr);
-                    return ip;
-            }
-            
     gdImageDestroy(ip);
     return ipr;
 }
@@ -2038,121 +2676,887 @@ reduce_shots_to_fit_in(
 }
 
 /*
- * return   0 ok
- *         -1 something went wrong
- *          1 some images are missing
- */
-int make_thumbnail(const char *file, const struct options *o, int nb_file)
+keep tiles of the sheet & sprite position for the next --incremental run
+return 0 if ok
+*/
+int save_inc_state(struct inc_state *inc, const struct thumbnail *tn, const struct sprite *sprite,
+    AVRational time_base, int64_t first_target, int nb_targets, const char *filename, const struct options *o)
 {
-    int return_code = -1;
-    av_log(NULL, AV_LOG_VERBOSE, "make_thumbnail: %s\n", file);
-    int idx = 0;
-    int thumb_nb = 0;
+    int i;
+    if (inc_state_alloc(inc, tn->idx + 1, tn->shot_width_out, tn->shot_height_out) == -1)
+        return -1;
+    inc->tb_num = time_base.num;
+    inc->tb_den = time_base.den;
+    inc->first_target = first_target;
+    inc->step_t = tn->step_t;
+    inc->nb_targets = nb_targets;
+    for (i = 0; i < inc->nb_tiles; i++)
+    {
+        int x, y;
+        thumb_shot_position(tn, i, &x, &y, o);
+        inc_state_put_tile(inc, i, tn->out_ip, x, y);
+        inc->pts[i] = tn->ppts[i];
+    }
+    if (sprite)
+    {
+        inc->sprite_file_idx = sprite->curr_file_idx;
+        inc->sprite_last_pts = sprite->last_shot_pts;
+    }
+    return inc_state_save(inc, filename);
+}
 
-    int64_t tstart = get_current_time();
+/*
+open url; regular local files & members of archives (bundle.tar#clip.mp4)
+are read through li with a large buffer (--io-buffer) or from a mapping
+(--mmap); http(s) urls through hc if --http-cache is set.
+return value is the same as avformat_open_input()'s
+*/
+int open_input(AVFormatContext **ppFormatCtx, const char *url, struct local_input *li, struct http_cache *hc,
+    const struct options *o)
+{
+    const char *member_name;
+    char *archive_file = archive_split_path(url, &member_name);
+    if (archive_file)
+    {
+        // archives are listed once for all of their members
+        if (!gb_archive_file || strcmp(gb_archive_file, archive_file))
+        {
+            archive_free(&gb_archive);
+            free(gb_archive_file);
+            gb_archive_file = NULL;
+            if (archive_open(&gb_archive, archive_file) == 0)
+                gb_archive_file = strdup(archive_file);
+        }
+        const struct archive_member *m = gb_archive_file ? archive_find(&gb_archive, member_name) : NULL;
+        int buffer_size = (o->io_buffer > 0 ? o->io_buffer : LOCAL_INPUT_BUFFER_SIZE) * 1024;
+        int ret = !m || local_input_open_range(li, archive_file, m->offset, m->size, buffer_size, o->mmap)
+            || !(*ppFormatCtx = avformat_alloc_context());
+        if (ret)
+            av_log(NULL, AV_LOG_ERROR, "  %s isn't a stored member of archive %s\n", member_name, archive_file);
+        free(archive_file);
+        if (ret)
+            return AVERROR(ENOENT);
+        (*ppFormatCtx)->pb = li->pb;
+    }
 
-    struct thumbnail tn; // thumbnail data & info
-    thumb_new(&tn);
+    if (o->http_cache && http_cache_is_url(url))
+    {
+        if (http_cache_open(hc, url, o->http_cache, o->http_cache_size, o->dict) == 0
+            && (*ppFormatCtx = avformat_alloc_context()))
+            (*ppFormatCtx)->pb = hc->pb;
+        else
+            av_log(NULL, AV_LOG_INFO, "  %s can't be cached; reading it directly\n", url);
+    }
 
-    struct string_buffer info_buf;
-    struct string_buffer individual_filename;
+    AVDictionary *dict = NULL;
+    if (o->dict)
+        av_dict_copy(&dict, o->dict, 0);
+    if (!li->pb && !hc->pb && strcmp(url, "pipe:0") != 0 && local_input_open(li, url, o->io_buffer * 1024, o->mmap) == 0
+        && (*ppFormatCtx = avformat_alloc_context()))
+        (*ppFormatCtx)->pb = li->pb;
+    int ret = avformat_open_input(ppFormatCtx, url, NULL, dict ? &dict : NULL);
+    if (dict)
+        av_dict_free(&dict);
+    return ret;
+}
 
-    sb_init(&info_buf);
-    sb_init(&individual_filename);
-    
-    struct sprite *sprite = NULL;
-    
-    gdImagePtr thumbShadowIm = NULL;
-    int shadow_radius = o->shadow;
+/*
+open url & read its stream information; *info_ret is avformat_find_stream_info()'s result.
+return value is the same as open_input()'s
+*/
+int probe_input(AVFormatContext **ppFormatCtx, const char *url, struct local_input *li, struct http_cache *hc,
+    const struct options *o, int *info_ret)
+{
+    *info_ret = 0;
+    int ret = open_input(ppFormatCtx, url, li, hc, o);
+    if (ret)
+        return ret;
 
-    int nb_shots = 0; // # of decoded shots (stat purposes)
+    // generate pts?? -- from ffplay, not documented
+    // it should make av_read_frame() generate pts for unknown value
+    assert(*ppFormatCtx);
+    (*ppFormatCtx)->flags |= AVFMT_FLAG_GENPTS;
 
-    /* these are checked during cleaning up, must be NULL if not used */
-    AVFormatContext *pFormatCtx = NULL;
-    AVCodecContext *pCodecCtx = NULL;
-    AVFrame *pFrame = NULL;
-    AVFrame *pFrameRGB = NULL;
-    uint8_t *rgb_buffer = NULL;
-    struct SwsContext *pSwsCtx = NULL;
-    tn.out_ip = NULL;
-    FILE *info_fp = NULL;
-    gdImagePtr ip = NULL;
-    tchar_t *out_filename = NULL;
-    tchar_t *info_filename = NULL;
+    // Retrieve stream information
+    *info_ret = avformat_find_stream_info(*ppFormatCtx, NULL);
+    return 0;
+}
 
-    int t_timestamp = o->t_timestamp; // local timestamp; can be turned off; 0 = off
-    int ret;
+/*
+probe_func of gb_probe_pool; runs in its threads
+*/
+static int probe_ahead(void *opaque, const char *url, AVFormatContext **ctx, struct local_input *li, int *info_ret)
+{
+    struct http_cache hc; // not used; cached urls aren't probed ahead
+    http_cache_init(&hc);
+    return probe_input(ctx, url, li, &hc, opaque, info_ret);
+}
 
-    if (nb_file)
-        av_log(NULL, AV_LOG_INFO, "\n");
+/*
+return 1 if file can be opened by gb_probe_pool. members of archives &
+cached urls share state with the main thread; standard input can't be
+read twice
+*/
+static int can_probe_ahead(const char *file, const struct options *o)
+{
+    if (!strcmp(file, "-") || (o->http_cache && http_cache_is_url(file)))
+        return 0;
+    const char *member_name;
+    char *archive_file = archive_split_path(file, &member_name);
+    free(archive_file);
+    return !archive_file;
+}
 
+/*
+set the output file names of tn from out_name, -O & -X. the sheet of
+stream_index >= 0 is named <movie>_s<stream_index><suffix>
+(--all-video-streams); info & cover files are per movie
+*/
+void thumb_set_filenames(struct thumbnail *tn, const char *out_name, int stream_index, const struct options *o)
+{
     if (o->O_outdir && *o->O_outdir)
     {
-        sb_add_string(&tn.base_filename, o->O_outdir);
-        sb_add_string(&tn.base_filename, FOLDER_SEPARATOR);
-        sb_add_string(&tn.base_filename, basename(file));
+        sb_add_string(&tn->base_filename, o->O_outdir);
+        sb_add_string(&tn->base_filename, FOLDER_SEPARATOR);
+        sb_add_string(&tn->base_filename, basename(out_name));
     }
     else
-        sb_add_string(&tn.base_filename, file);
+        sb_add_string(&tn->base_filename, out_name);
 
     if (!o->X_filename_use_full)
     {
-        const char *filename = basename(tn.base_filename.s);
+        const char *filename = basename(tn->base_filename.s);
         const char *extpos = strrchr(filename, '.');
         // remove movie extenxtion (e.g. .avi)
         if (extpos)
-            sb_shrink(&tn.base_filename, extpos - tn.base_filename.s);
+            sb_shrink(&tn->base_filename, extpos - tn->base_filename.s);
     }
 
-    sb_add_buffer(&tn.out_filename, &tn.base_filename);
-    sb_add_string(&tn.out_filename, o->o_suffix);
-
     if (o->N_suffix && *o->N_suffix)
     {
-        sb_add_buffer(&tn.info_filename, &tn.base_filename);
-        sb_add_string(&tn.info_filename, o->N_suffix);
+        sb_add_buffer(&tn->info_filename, &tn->base_filename);
+        sb_add_string(&tn->info_filename, o->N_suffix);
     }
 
     if (o->cover)
     {
-        sb_add_buffer(&tn.cover_filename, &tn.base_filename);
-        sb_add_string(&tn.cover_filename, o->cover_suffix);
+        sb_add_buffer(&tn->cover_filename, &tn->base_filename);
+        sb_add_string(&tn->cover_filename, o->cover_suffix);
     }
 
-    // idenfity thumbnail image extension
-    const char *image_extension;
-    const char *suffix = strrchr(tn.out_filename.s, '.');
-    if (suffix && strcasecmp(suffix, ".png") == 0)
-        image_extension = IMAGE_EXTENSION_PNG;
-    else
-        image_extension = IMAGE_EXTENSION_JPG;
-
-    out_filename = utf8_to_tchar(tn.out_filename.s);
-    if (tn.info_filename.len)
-        info_filename = utf8_to_tchar(tn.info_filename.s);
-    
-#if 0
-    // if output files exist and modified time >= program start time,
-    // we'll not overwrite and use a new name
-    int unum = 0;
-    if (is_reg_newer(out_filename, gb_st_start))
+    if (stream_index >= 0)
     {
-        unum = make_unique_name(tn.out_filename, gb_o_suffix, unum);
-        av_log(NULL, AV_LOG_INFO, "%s: output file already exists. using: %s\n", gb_argv0, tn.out_filename);
-        free_conv_result(out_filename);
-        out_filename = utf8_to_tchar(tn.out_filename);
+        char tmp_buf[64];
+        sb_add_string_len(&tn->base_filename, tmp_buf, sprintf(tmp_buf, "_s%d", stream_index));
     }
-    if (gb_N_suffix && is_reg_newer(info_filename, gb_st_start))
+    sb_add_buffer(&tn->out_filename, &tn->base_filename);
+    sb_add_string(&tn->out_filename, o->o_suffix);
+}
+
+/*
+finish the layout of tn after reduce_shots_to_fit_in(): size of the shots
+as stored in the movie & height of the image with info_text; NULL = none
+*/
+void thumb_finish_layout(struct thumbnail *tn, const char *info_text, int info_text_padding, const struct options *o)
+{
+    if (abs(tn->rotation) == 90)
     {
-        unum = make_unique_name(tn.info_filename, gb_N_suffix, unum);
-        av_log(NULL, AV_LOG_INFO, "%s: info file already exists. using: %s\n", gb_argv0, tn.info_filename);
-        free_conv_result(info_filename);
-        info_filename = utf8_to_tchar(tn.info_filename);
+        tn->shot_height_in = tn->shot_width_out;
+        tn->shot_width_in  = tn->shot_height_out;
+    }
+    else
+    {
+        tn->shot_height_in = tn->shot_height_out;
+        tn->shot_width_in  = tn->shot_width_out;
+    }
+    if (info_text)
+        tn->txt_height = image_string_height(info_text, o->f_fontname, o->F_info_font_size) + o->g_gap + info_text_padding;
+    tn->img_height = tn->shot_height_out*tn->row + o->g_gap*(tn->row+1) + tn->txt_height;
+}
+
+/*
+create the output image of tn filled with the background color & draw
+info_text into it; *background is set to the color.
+return 0 if ok
+*/
+int thumb_create_canvas(struct thumbnail *tn, char *info_text, int info_text_padding, int *background,
+    const struct options *o)
+{
+    tn->out_ip = gdImageCreateTrueColor(tn->img_width, tn->img_height);
+    if (!tn->out_ip)
+    {
+        av_log(NULL, AV_LOG_ERROR, "  gdImageCreateTrueColor failed: width %d, height %d\n", tn->img_width, tn->img_height);
+        return -1;
+    }
+
+    /* setting alpha blending is not needed, using default mode:
+     * https://libgd.github.io/manuals/2.2.5/files/gd-h.html#Effects
+    gdImageAlphaBlending(tn->out_ip,
+        //gdEffectReplace		//replace pixels
+        gdEffectAlphaBlend	   	//blend pixels, see gdAlphaBlend
+        //gdEffectNormal		//default mode; same as gdEffectAlphaBlend
+        //gdEffectOverlay		//overlay pixels, see gdLayerOverlay
+        //gdEffectMultiply	//overlay pixels with multiply effect, see gdLayerMultiply
+    );
+    */
+    *background = gdImageColorResolve(tn->out_ip, RGB_R(o->k_bcolor), RGB_G(o->k_bcolor), RGB_B(o->k_bcolor)); // set backgroud
+    gdImageFilledRectangle(tn->out_ip, 0, 0, tn->img_width, tn->img_height, *background);
+
+    if (o->transparent_bg)
+        gdImageColorTransparent(tn->out_ip, *background);
+
+    /* add info & text */ // do this early so when font is not found we'll quit early
+    if (info_text && *info_text)
+    {
+        char *error = image_string(tn->out_ip,
+            o->f_fontname, o->F_info_color, o->F_info_font_size,
+            o->L_info_location, o->g_gap, info_text, 0, COLOR_WHITE, info_text_padding);
+        if (error)
+        {
+            av_log(NULL, AV_LOG_ERROR, "  %s; font problem? see -f option\n", error);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+allocate *pFrameRGB & *rgb_buffer for width x height AV_PIX_FMT_RGB24 shots.
+return the size of the buffer, -1 if failed
+*/
+int alloc_rgb_frame(AVFrame **pFrameRGB, uint8_t **rgb_buffer, int width, int height)
+{
+    *pFrameRGB = av_frame_alloc();
+    if (!*pFrameRGB)
+    {
+        av_log(NULL, AV_LOG_ERROR, "  couldn't allocate a video frame\n");
+        return -1;
+    }
+    int rgb_bufsize = av_image_get_buffer_size(AV_PIX_FMT_RGB24, width, height, LINESIZE_ALIGN);
+    *rgb_buffer = av_malloc(rgb_bufsize);
+    if (!*rgb_buffer)
+    {
+        av_log(NULL, AV_LOG_ERROR, "  av_malloc %d bytes failed\n", rgb_bufsize);
+        return -1;
+    }
+    // Returns: the size in bytes required for src, a negative error code in case of failure
+    int ret = av_image_fill_arrays((*pFrameRGB)->data, (*pFrameRGB)->linesize, *rgb_buffer, AV_PIX_FMT_RGB24, width, height, LINESIZE_ALIGN);
+    if (ret < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "  av_image_fill_arrays failed (%d)\n", ret);
+        return -1;
+    }
+    return rgb_bufsize;
+}
+
+/*
+timestamp glyphs of -F, rasterized once per batch & owned by the render
+cache; *padding is set to their padding. NULL if the font couldn't be used
+*/
+const struct glyph_atlas *open_timestamp_glyphs(int *padding, const struct options *o)
+{
+    char *str_ret = NULL;
+    const struct glyph_atlas *ga = render_cache_glyphs(o->F_ts_fontname, o->F_ts_font_size, &str_ret);
+    if (!ga)
+    {
+        av_log(NULL, AV_LOG_ERROR, "  %s; font problem? see -f option or -F option\n", str_ret);
+        return NULL;
+    }
+    *padding = image_string_padding(o->F_ts_fontname, o->F_ts_font_size);
+    return ga;
+}
+
+/*
+hint the byte range of planned shot i, so it's read while earlier shots are decoded
+*/
+void prefetch_shot(struct local_input *li, AVStream *st, const struct shot_plan *plan, int i)
+{
+    int64_t pos, size;
+    if (i < plan->nb_targets && !plan->approx[i] && shot_plan_byte_range(st, plan->targets[i], &pos, &size) == 0)
+        local_input_willneed(li, pos, size);
+}
+
+/*
+sheet of one video stream in --all-video-streams mode
+*/
+struct stream_sheet
+{
+    int index; // stream index
+    AVCodecContext *pCodecCtx;
+    struct SwsContext *pSwsCtx;
+    struct pyramid pyr; // before pSwsCtx
+    AVFrame *pFrameRGB;
+    uint8_t *rgb_buffer;
+    gdImagePtr shadow; // from & back to the render cache
+    struct shadow_key shadow_key;
+    int shadow_radius;
+    const struct glyph_atlas *ts_glyphs; // if -t; owned by the render cache
+    int ts_padding;
+    struct thumbnail tn;
+    int64_t first_target; // in time_base unit
+    int nb_targets;
+    int target_idx; // index of the next target
+    int nb_shots;
+};
+
+/* pts of decoded frame in time_base unit */
+int64_t frame_pts(const AVFrame *pFrame)
+{
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(55, 34, 100)
+    return pFrame->pts;
+#else
+    return pFrame->pkt_pts;
+#endif
+}
+
+void stream_sheet_free(struct stream_sheet *sh)
+{
+    if (sh->tn.out_ip)
+        gdImageDestroy(sh->tn.out_ip);
+    if (sh->shadow)
+        render_cache_put_shadow(sh->shadow, &sh->shadow_key, sh->shadow_radius);
+    if (sh->pSwsCtx)
+        sws_freeContext(sh->pSwsCtx);
+    pyramid_free(&sh->pyr);
+    if (sh->rgb_buffer)
+        av_free(sh->rgb_buffer);
+    if (sh->pFrameRGB)
+        av_free(sh->pFrameRGB);
+    if (sh->pCodecCtx)
+    {
+        avcodec_close(sh->pCodecCtx);
+        avcodec_free_context(&sh->pCodecCtx);
+    }
+    thumb_cleanup_dynamic(&sh->tn);
+}
+
+/*
+open decoder & create empty sheet for stream st; the file names of sh->tn
+must be set
+return 0 if ok
+*/
+int stream_sheet_init(struct stream_sheet *sh, AVFormatContext *pFormatCtx, AVStream *st, const char *file,
+    double start_time, double net_duration, const struct options *o)
+{
+    struct thumbnail *tn = &sh->tn;
+    sh->index = st->index;
+    tn->time_base = av_q2d(st->time_base);
+    tn->rotation = (int) get_stream_rotation(st);
+
+    /* decoder */
+    sh->pCodecCtx = get_codecContext_from_codecParams(st->codecpar);
+    if (!sh->pCodecCtx)
+        return -1;
+    const AVCodec *pCodec = avcodec_find_decoder(sh->pCodecCtx->codec_id);
+    if (!pCodec)
+    {
+        av_log(NULL, AV_LOG_ERROR, "  couldn't find a decoder for codec_id: %d\n", sh->pCodecCtx->codec_id);
+        return -1;
+    }
+    if (o->s_step >= 0)
+        sh->pCodecCtx->skip_frame = AVDISCARD_NONREF;
+    // the file is demuxed once from start to end
+    set_decoder_threading(sh->pCodecCtx, pCodec, o->c_column * MAX(o->r_row, 1), net_duration, 1, o);
+    sh->pCodecCtx->pkt_timebase = st->time_base;
+    int ret = avcodec_open2(sh->pCodecCtx, pCodec, NULL);
+    if (ret < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "  couldn't open codec %s id %d: %d\n", pCodec->name, pCodec->id, ret);
+        return -1;
+    }
+
+    /* layout */
+    AVRational sample_aspect_ratio = av_guess_sample_aspect_ratio(pFormatCtx, st, NULL);
+    int scaled_src_width, scaled_src_height;
+    calc_scale_src(sh->pCodecCtx->width, sh->pCodecCtx->height, sample_aspect_ratio,
+        &scaled_src_width, &scaled_src_height);
+    int scaled_src_width_out = scaled_src_width, scaled_src_height_out = scaled_src_height;
+    if (abs(tn->rotation) == 90)
+    {
+        scaled_src_width_out  = scaled_src_height;
+        scaled_src_height_out = scaled_src_width;
+    }
+    reduce_shots_to_fit_in(o->s_step, o->r_row, o->c_column,
+        scaled_src_width_out, scaled_src_height_out, (int) net_duration, tn, o);
+    if (tn->column == 0 || tn->step_t == 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "  stream #%d: thumbnail too small or movie too short\n", st->index);
+        return -1;
+    }
+
+    struct string_buffer info_buf;
+    sb_init(&info_buf);
+    if (o->i_info)
+    {
+        char tmp_buf[64];
+        get_stream_info(&info_buf, pFormatCtx, file, 1, sample_aspect_ratio, o);
+        sb_add_string_len(&info_buf, tmp_buf, sprintf(tmp_buf, "\nSheet of stream #%d", st->index));
+    }
+    if (o->T_text && *o->T_text)
+    {
+        sb_add_char(&info_buf, '\n');
+        sb_add_string(&info_buf, o->T_text);
+    }
+    const int info_text_padding = image_string_padding(o->f_fontname, o->F_info_font_size);
+    thumb_finish_layout(tn, o->i_info ? info_buf.s : NULL, info_text_padding, o);
+    av_log(NULL, AV_LOG_INFO, "  stream #%d: step: %.1f s; # tiles: %dx%d, tile size: %dx%d; total size: %dx%d\n", st->index,
+        tn->step_t*tn->time_base, tn->column, tn->row, tn->shot_width_out, tn->shot_height_out, tn->img_width, tn->img_height);
+
+    /* canvas */
+    ret = -1;
+    int background;
+    if (thumb_create_canvas(tn, info_buf.s, info_text_padding, &background, o))
+        goto cleanup;
+    sh->shadow_radius = o->shadow;
+    if (o->shadow >= 0
+        && !(sh->shadow = get_shadow_image(background, tn->shot_width_out, tn->shot_height_out, &sh->shadow_radius,
+            &sh->shadow_key, o)))
+        goto cleanup;
+    if (thumb_alloc_dynamic(tn) == -1)
+    {
+        av_log(NULL, AV_LOG_ERROR, "  thumb_alloc_dynamic failed\n");
+        goto cleanup;
+    }
+
+    /* scaler */
+    if (alloc_rgb_frame(&sh->pFrameRGB, &sh->rgb_buffer, tn->shot_width_in, tn->shot_height_in) < 0)
+        goto cleanup;
+    if (pyramid_open(&sh->pyr, sh->pCodecCtx->width, sh->pCodecCtx->height, sh->pCodecCtx->pix_fmt,
+            tn->shot_width_in, tn->shot_height_in))
+    {
+        av_log(NULL, AV_LOG_ERROR, "  couldn't allocate a video frame\n");
+        goto cleanup;
+    }
+    sh->pSwsCtx = sws_getContext(sh->pyr.width, sh->pyr.height, sh->pCodecCtx->pix_fmt,
+        tn->shot_width_in, tn->shot_height_in, AV_PIX_FMT_RGB24, o->sws_flags, NULL, NULL, NULL);
+    if (!sh->pSwsCtx)
+    {
+        av_log(NULL, AV_LOG_ERROR, "  sws_getContext failed\n");
+        goto cleanup;
+    }
+    if (o->t_timestamp && !(sh->ts_glyphs = open_timestamp_glyphs(&sh->ts_padding, o)))
+        goto cleanup;
+
+    sh->first_target = tn->step_t + (int64_t) ((start_time + o->B_begin) / tn->time_base);
+    sh->nb_targets = tn->row * tn->column;
+    ret = 0;
+
+  cleanup:
+    sb_destroy(&info_buf);
+    return ret;
+}
+
+/*
+add decoded frame as the next shot of sheet sh
+return 0 if ok
+*/
+int stream_sheet_add_shot(struct stream_sheet *sh, AVFrame *pFrame, int64_t pts, AVRational time_base, double start_time,
+    const struct options *o)
+{
+    struct thumbnail *tn = &sh->tn;
+    const AVFrame *pScaleFrame = pyramid_reduce(&sh->pyr, pFrame);
+    if (sws_scale(sh->pSwsCtx, (const uint8_t* const*)pScaleFrame->data, pScaleFrame->linesize, 0, sh->pyr.height,
+        sh->pFrameRGB->data, sh->pFrameRGB->linesize) <= 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "  sws_scale() failed\n");
+        return -1;
+    }
+    gdImagePtr ip = gdImageCreateTrueColor(tn->shot_width_in, tn->shot_height_in);
+    if (!ip)
+    {
+        av_log(NULL, AV_LOG_ERROR, "  gdImageCreateTrueColor failed: width %d, height %d\n", tn->shot_width_in, tn->shot_height_in);
+        return -1;
+    }
+    FrameRGB_2_gdImage(sh->pFrameRGB, ip, tn->shot_width_in, tn->shot_height_in);
+    ip = rotate_gdImage(ip, tn->rotation);
+
+    if (o->t_timestamp)
+    {
+        char time_str[64];
+        format_time(calc_time(pts, time_base, start_time), time_str, sizeof(time_str), ':');
+        char *str_ret = image_glyphs_rect(ip, 0, 0, gdImageSX(ip), gdImageSY(ip), sh->ts_glyphs,
+            o->F_ts_color, o->L_time_location, 0, time_str, 1, o->F_ts_shadow, sh->ts_padding);
+        if (str_ret)
+        {
+            av_log(NULL, AV_LOG_ERROR, "  %s; font problem? see -f option or -F option\n", str_ret);
+            gdImageDestroy(ip);
+            return -1;
+        }
+    }
+
+    thumb_add_shot(tn, ip, sh->shadow, sh->shadow_radius, sh->nb_shots++, pts, o);
+    gdImageDestroy(ip);
+    return 0;
+}
+
+/*
+decode the frames of packet pkt, NULL = flush, into the shots of sheet sh
+return 0 if ok
+*/
+int stream_sheet_decode(struct stream_sheet *sh, AVPacket *pkt, AVFrame *pFrame, AVRational time_base,
+    double start_time, const struct options *o)
+{
+    if (avcodec_send_packet(sh->pCodecCtx, pkt) < 0)
+        return 0; // invalid packets are ignored like in get_frame_from_packet()
+
+    while (avcodec_receive_frame(sh->pCodecCtx, pFrame) == 0)
+    {
+        int64_t pts = frame_pts(pFrame);
+        if (pts == AV_NOPTS_VALUE || sh->target_idx >= sh->nb_targets
+            || pts < sh->first_target + sh->target_idx * sh->tn.step_t)
+            continue;
+        if (stream_sheet_add_shot(sh, pFrame, pts, time_base, start_time, o))
+            return -1;
+        // targets this frame is already past are skipped
+        while (sh->target_idx < sh->nb_targets && sh->first_target + sh->target_idx * sh->tn.step_t <= pts)
+            sh->target_idx++;
+    }
+    return 0;
+}
+
+/*
+--all-video-streams: one sheet per video stream from a single demux pass.
+packets are routed to the decoder of their stream; when every stream waits
+for a shot far ahead, all of them are seeked together.
+return value is the same as make_thumbnail()'s
+*/
+int make_thumbnails_all_streams(const char *file, const struct options *o, int nb_file)
+{
+    int return_code = -1;
+    AVFormatContext *pFormatCtx = NULL;
+    struct local_input li;
+    local_input_init(&li);
+    struct http_cache hc;
+    http_cache_init(&hc);
+    AVFrame *pFrame = NULL;
+    AVPacket *pkt = NULL;
+    struct stream_sheet *sheets = NULL;
+    int nb_sheets = 0;
+    char *archive_name = archive_output_name(file); // see make_thumbnail()
+    unsigned int i;
+    int ret;
+
+    if (nb_file)
+        av_log(NULL, AV_LOG_INFO, "\n");
+
+    ret = open_input(&pFormatCtx, file, &li, &hc, o);
+    if (ret)
+    {
+        av_log(NULL, AV_LOG_ERROR, "\n%s: avformat_open_input %s failed: %d\n", gb_argv0, file, ret);
+        goto cleanup;
+    }
+    pFormatCtx->flags |= AVFMT_FLAG_GENPTS;
+    ret = avformat_find_stream_info(pFormatCtx, NULL);
+    if (ret < 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "\n%s: avformat_find_stream_info %s failed: %d\n", gb_argv0, file, ret);
+        goto cleanup;
+    }
+    dump_format_context(pFormatCtx, nb_file, file, o);
+
+    double duration = (double) pFormatCtx->duration / AV_TIME_BASE;
+    if (duration <= 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "  duration is unknown: %.2f\n", duration);
+        goto cleanup;
+    }
+    double start_time = (double) pFormatCtx->start_time / AV_TIME_BASE;
+    if (start_time < 0)
+        start_time = 0;
+    double net_duration = o->C_cut > 0 ? MIN(o->C_cut, duration - o->B_begin) : duration - o->B_begin - o->E_end;
+    if (net_duration <= 0)
+    {
+        av_log(NULL, AV_LOG_ERROR, "  duration: %.2f s, net duration after -B & -E is negative: %.2f s.\n", duration, net_duration);
+        goto cleanup;
+    }
+
+    sheets = calloc(pFormatCtx->nb_streams, sizeof(*sheets));
+    pFrame = av_frame_alloc();
+    pkt = av_packet_alloc();
+    if (!sheets || !pFrame || !pkt)
+    {
+        av_log(NULL, AV_LOG_ERROR, "  couldn't allocate a video frame\n");
+        goto cleanup;
+    }
+
+    /* decoders run side by side; cpus are shared among them */
+    int nb_video = 0;
+    for (i = 0; i < pFormatCtx->nb_streams; i++)
+        if (pFormatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO
+            && !(pFormatCtx->streams[i]->disposition & AV_DISPOSITION_ATTACHED_PIC))
+            nb_video++;
+    int saved_jobs = gb_decoder_jobs;
+    gb_decoder_jobs *= MAX(nb_video, 1);
+    int nb_omitted = 0, cover_saved = 0;
+    for (i = 0; i < pFormatCtx->nb_streams; i++)
+    {
+        AVStream *st = pFormatCtx->streams[i];
+        if (st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO || (st->disposition & AV_DISPOSITION_ATTACHED_PIC))
+        {
+            st->discard = AVDISCARD_ALL;
+            continue;
+        }
+        struct stream_sheet *sh = &sheets[nb_sheets];
+        thumb_new(&sh->tn);
+        thumb_set_filenames(&sh->tn, archive_name ? archive_name : file, st->index, o);
+        int omitted = 0;
+        if (!o->W_overwrite) // don't overwrite mode
+        {
+            const tchar_t *out_filename = utf8_to_tchar(sh->tn.out_filename.s);
+            if ((omitted = is_reg(out_filename)))
+                av_log(NULL, AV_LOG_INFO, "%s: output file %s already exists. omitted.\n", gb_argv0, sh->tn.out_filename.s);
+            free_conv_result(out_filename);
+        }
+        nb_omitted += omitted;
+        if (o->cover && !omitted && !cover_saved)
+        {
+            save_cover_image(pFormatCtx, sh->tn.cover_filename.s); // the cover is per movie
+            cover_saved = 1;
+        }
+        if (omitted || stream_sheet_init(sh, pFormatCtx, st, file, start_time, net_duration, o))
+        {
+            // the other streams might still be fine
+            stream_sheet_free(sh);
+            memset(sh, 0, sizeof(*sh));
+            st->discard = AVDISCARD_ALL;
+            continue;
+        }
+        nb_sheets++;
+    }
+    gb_decoder_jobs = saved_jobs;
+    if (!nb_sheets)
+    {
+        if (nb_omitted)
+            return_code = 0;
+        else
+            av_log(NULL, AV_LOG_ERROR, "  couldn't find a video stream\n");
+        goto cleanup;
+    }
+
+    /* single demux pass */
+    int seek_mode = !o->Z_nonseek && pFormatCtx->pb && (pFormatCtx->pb->seekable & AVIO_SEEKABLE_NORMAL);
+    local_input_set_sequential(&li, !seek_mode);
+    int64_t last_read = AV_NOPTS_VALUE, sought = AV_NOPTS_VALUE; // in AV_TIME_BASE unit
+    int s;
+    while (1)
+    {
+        int64_t next = INT64_MAX; // earliest target of all streams
+        for (s = 0; s < nb_sheets; s++)
+            if (sheets[s].target_idx < sheets[s].nb_targets)
+            {
+                struct stream_sheet *sh = &sheets[s];
+                AVStream *st = pFormatCtx->streams[sh->index];
+                int64_t target = sh->first_target + sh->target_idx * sh->tn.step_t;
+                next = MIN(next, av_rescale_q(target, st->time_base, AV_TIME_BASE_Q));
+            }
+        if (next == INT64_MAX)
+            break; // all sheets are full
+
+        // usually movies have key frames every 10 s
+        if (seek_mode && next != sought && (last_read == AV_NOPTS_VALUE || next - last_read > 10 * AV_TIME_BASE))
+        {
+            if (av_seek_frame(pFormatCtx, -1, next, AVSEEK_FLAG_BACKWARD) >= 0)
+                for (s = 0; s < nb_sheets; s++)
+                    avcodec_flush_buffers(sheets[s].pCodecCtx);
+            sought = next;
+        }
+
+        ret = av_read_frame(pFormatCtx, pkt);
+        if (ret < 0)
+        {
+            // end of file; frames still in the decoders can be shots too
+            for (s = 0; s < nb_sheets; s++)
+                if (sheets[s].target_idx < sheets[s].nb_targets
+                    && stream_sheet_decode(&sheets[s], NULL, pFrame, pFormatCtx->streams[sheets[s].index]->time_base, start_time, o))
+                    goto cleanup;
+            break;
+        }
+        struct stream_sheet *sh = NULL;
+        for (s = 0; s < nb_sheets; s++)
+            if (sheets[s].index == pkt->stream_index)
+                sh = &sheets[s];
+        if (!sh || sh->target_idx >= sh->nb_targets)
+        {
+            av_packet_unref(pkt);
+            continue;
+        }
+        AVStream *st = pFormatCtx->streams[sh->index];
+        if (pkt->pts != AV_NOPTS_VALUE)
+            last_read = av_rescale_q(pkt->pts, st->time_base, AV_TIME_BASE_Q);
+
+        ret = stream_sheet_decode(sh, pkt, pFrame, st->time_base, start_time, o);
+        av_packet_unref(pkt);
+        if (ret)
+            goto cleanup;
+    }
+
+    /* save sheets */
+    return_code = 0;
+    for (s = 0; s < nb_sheets; s++)
+    {
+        struct stream_sheet *sh = &sheets[s];
+        struct thumbnail *tn = &sh->tn;
+        if (!sh->nb_shots)
+        {
+            av_log(NULL, AV_LOG_ERROR, "  stream #%d: no shots\n", sh->index);
+            return_code = -1;
+            continue;
+        }
+        /* crop if we dont get enough shots */
+        const int created_rows = (sh->nb_shots + tn->column - 1) / tn->column;
+        if (created_rows < tn->row || (created_rows == 1 && sh->nb_shots < tn->column))
+        {
+            tn->img_height -= (tn->row - created_rows) * tn->shot_height_out;
+            if (created_rows == 1)
+                tn->img_width -= (tn->column - sh->nb_shots) * tn->shot_width_out;
+            tn->out_ip = crop_image(tn->out_ip, tn->img_width, tn->img_height);
+        }
+        if (save_image(tn->out_ip, tn->out_filename.s, o))
+        {
+            return_code = -1;
+            continue;
+        }
+        av_log(NULL, AV_LOG_INFO, "  stream #%d: %d shots; output: %s\n", sh->index, sh->nb_shots, tn->out_filename.s);
+        if (sh->nb_shots != sh->nb_targets && return_code == 0)
+            return_code = 1; // warning - some images are missing
+    }
+
+  cleanup:
+    if (sheets)
+        for (s = 0; s < nb_sheets; s++)
+            stream_sheet_free(&sheets[s]);
+    free(sheets);
+    av_packet_free(&pkt);
+    if (pFrame)
+        av_free(pFrame);
+    if (pFormatCtx)
+        avformat_close_input(&pFormatCtx);
+    local_input_close(&li);
+    http_cache_close(&hc);
+    free(archive_name);
+    return return_code;
+}
+
+/*
+ * return   0 ok
+ *         -1 something went wrong
+ *          1 some images are missing
+ */
+int make_thumbnail(const char *file, const struct options *o, int nb_file)
+{
+    int return_code = -1;
+    av_log(NULL, AV_LOG_VERBOSE, "make_thumbnail: %s\n", file);
+    if (o->all_video_streams)
+        return make_thumbnails_all_streams(file, o, nb_file);
+    int idx = 0;
+    int thumb_nb = 0;
+
+    int64_t tstart = get_current_time();
+
+    struct thumbnail tn; // thumbnail data & info
+    thumb_new(&tn);
+
+    struct string_buffer info_buf;
+    struct string_buffer individual_filename;
+
+    sb_init(&info_buf);
+    sb_init(&individual_filename);
+    
+    struct sprite *sprite = NULL;
+    
+    gdImagePtr thumbShadowIm = NULL;
+    int shadow_radius = o->shadow;
+
+    struct shot_plan plan;
+    shot_plan_init(&plan);
+    struct reservoir rsv; // candidates of non-seekable input
+    reservoir_init(&rsv);
+    struct inc_state inc; // shots of previous --incremental run
+    inc_state_init(&inc);
+    struct string_buffer inc_filename;
+    sb_init(&inc_filename);
+    char *archive_name = NULL;
+
+    // "-" reads from standard input
+    const char *url = file;
+    if (strcmp(file, "-") == 0)
+        url = "pipe:0";
+
+    int nb_shots = 0; // # of decoded shots (stat purposes)
+
+    /* these are checked during cleaning up, must be NULL if not used */
+    AVFormatContext *pFormatCtx = NULL;
+    struct local_input li;
+    local_input_init(&li);
+    struct http_cache hc;
+    http_cache_init(&hc);
+    AVCodecContext *pCodecCtx = NULL;
+    AVFrame *pFrame = NULL;
+    AVFrame *pFrameRGB = NULL;
+    uint8_t *rgb_buffer = NULL;
+    struct SwsContext *pSwsCtx = NULL; // owned by decoder pool
+    struct tile_scaler tiles; // shots scaled straight into the output image
+    tile_scaler_init(&tiles);
+    struct pyramid pyr; // big frames are halved before swscale
+    pyramid_init(&pyr);
+    struct gray_shot gray; // for blank & edge evasion
+    gray_shot_init(&gray);
+    const struct glyph_atlas *ts_glyphs = NULL; // owned by the render cache
+    struct shadow_key shadow_key;
+    struct decoder_key dec_key; // parameters pCodecCtx was opened with
+    const int decode_errors = gb_decode_errors; // before this file
+    memset(&dec_key, 0, sizeof(dec_key));
+    tn.out_ip = NULL;
+    FILE *info_fp = NULL;
+    gdImagePtr ip = NULL;
+    tchar_t *out_filename = NULL;
+    tchar_t *info_filename = NULL;
+
+    int t_timestamp = o->t_timestamp; // local timestamp; can be turned off; 0 = off
+    int ret;
+
+    if (nb_file)
+        av_log(NULL, AV_LOG_INFO, "\n");
+
+    // members of archives are named after the archive: bundle.tar_inner_clip.mp4
+    archive_name = archive_output_name(file);
+    const char *out_name = url != file ? "stdin" : archive_name ? archive_name : file;
+    thumb_set_filenames(&tn, out_name, -1, o);
+
+    // idenfity thumbnail image extension
+    const char *image_extension;
+    const char *suffix = strrchr(tn.out_filename.s, '.');
+    if (suffix && strcasecmp(suffix, ".png") == 0)
+        image_extension = IMAGE_EXTENSION_PNG;
+    else
+        image_extension = IMAGE_EXTENSION_JPG;
+
+    out_filename = utf8_to_tchar(tn.out_filename.s);
+    if (tn.info_filename.len)
+        info_filename = utf8_to_tchar(tn.info_filename.s);
+    
+#if 0
+    // if output files exist and modified time >= program start time,
+    // we'll not overwrite and use a new name
+    int unum = 0;
+    if (is_reg_newer(out_filename, gb_st_start))
+    {
+        unum = make_unique_name(tn.out_filename, gb_o_suffix, unum);
+        av_log(NULL, AV_LOG_INFO, "%s: output file already exists. using: %s\n", gb_argv0, tn.out_filename);
+        free_conv_result(out_filename);
+        out_filename = utf8_to_tchar(tn.out_filename);
+    }
+    if (gb_N_suffix && is_reg_newer(info_filename, gb_st_start))
+    {
+        unum = make_unique_name(tn.info_filename, gb_N_suffix, unum);
+        av_log(NULL, AV_LOG_INFO, "%s: info file already exists. using: %s\n", gb_argv0, tn.info_filename);
+        free_conv_result(info_filename);
+        info_filename = utf8_to_tchar(tn.info_filename);
     }
 #endif
     if (!o->W_overwrite) // don't overwrite mode
     {
-        if (is_reg(out_filename))
+        if (!o->metadata_only && is_reg(out_filename))
         {
             av_log(NULL, AV_LOG_INFO, "%s: output file %s already exists. omitted.\n", gb_argv0, tn.out_filename.s);
             return_code = 0;
@@ -2176,26 +3580,16 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
         }
     }
 
-    // Open video file
-    AVDictionary *dict = NULL;
-    if (o->dict)
-        av_dict_copy(&dict, o->dict, 0);
-    ret = avformat_open_input(&pFormatCtx, file, NULL, dict ? &dict : NULL);
-    if (dict)
-        av_dict_free(&dict);
+    // Open video file; the probe pool might have opened it while the previous file was processed
+    int info_ret;
+    if (!probe_pool_take(gb_probe_pool, url, &pFormatCtx, &li, &ret, &info_ret))
+        ret = probe_input(&pFormatCtx, url, &li, &hc, o, &info_ret);
     if (ret)
     {
         av_log(NULL, AV_LOG_ERROR, "\n%s: avformat_open_input %s failed: %d\n", gb_argv0, file, ret);
         goto cleanup;
     }
-
-    // generate pts?? -- from ffplay, not documented
-    // it should make av_read_frame() generate pts for unknown value
-    assert(pFormatCtx);
-    pFormatCtx->flags |= AVFMT_FLAG_GENPTS;
-
-    // Retrieve stream information
-    ret = avformat_find_stream_info(pFormatCtx, NULL);
+    ret = info_ret;
     if (ret < 0)
     {
         av_log(NULL, AV_LOG_ERROR, "\n%s: avformat_find_stream_info %s failed: %d\n", gb_argv0, file, ret);
@@ -2205,6 +3599,38 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
 
     // Find videostream
     int video_index = find_default_videostream_index(pFormatCtx, o->S_select_video_stream);
+
+    /* info text & album art only; no decoder, frames or output image needed */
+    if (o->metadata_only)
+    {
+        if (o->cover)
+            save_cover_image(pFormatCtx, tn.cover_filename.s);
+        if (info_fp)
+        {
+            AVRational sar = { 0, 1 };
+            if (video_index != -1)
+            {
+                const AVCodecParameters *par = pFormatCtx->streams[video_index]->codecpar;
+                sar = av_guess_sample_aspect_ratio(pFormatCtx, pFormatCtx->streams[video_index], NULL);
+                if (o->a_ratio_num && par->width > 0)
+                {
+                    sar.num = (double) par->height * o->a_ratio_num / o->a_ratio_den / par->width * 10000;
+                    sar.den = 10000;
+                }
+            }
+            get_stream_info(&info_buf, pFormatCtx, file, 1, sar, o);
+            fputs(info_buf.s, info_fp);
+            fputc('\n', info_fp);
+            if (o->T_text && *o->T_text)
+            {
+                fputs(o->T_text, info_fp);
+                fputc('\n', info_fp);
+            }
+        }
+        return_code = 0;
+        goto cleanup;
+    }
+
     if (video_index == -1)
     {
         if (!o->S_select_video_stream)
@@ -2248,12 +3674,46 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
         pCodecCtx->skip_frame = AVDISCARD_NONREF; // internal err msg but not crash
     }
 
-    // Open codec
-    ret = avcodec_open2(pCodecCtx, pCodec, NULL);
-    if (ret < 0)
+    // pipes & other non-seekable inputs are decoded in a single pass
+    int stream_mode = pFormatCtx->pb && !(pFormatCtx->pb->seekable & AVIO_SEEKABLE_NORMAL);
+
+    int nb_planned_shots = o->at_count ? o->at_count
+        : o->r_row > 0 ? o->c_column * o->r_row
+        : o->s_step > 0 ? (int) (pFormatCtx->duration / AV_TIME_BASE / o->s_step) : 0;
+    set_decoder_threading(pCodecCtx, pCodec, nb_planned_shots, (double) pFormatCtx->duration / AV_TIME_BASE,
+        stream_mode, o);
+
+    pCodecCtx->pkt_timebase = pStream->time_base;
+
+    // Open codec, or take the one of a previous file with the same parameters
+    decoder_key_from_params(&dec_key, pStream->codecpar);
+    dec_key.thread_type = pCodecCtx->thread_type;
+    dec_key.thread_count = pCodecCtx->thread_count;
+    AVCodecContext *pooled = decoder_pool_get(&dec_key);
+    if (pooled)
     {
-        av_log(NULL, AV_LOG_ERROR, "  couldn't open codec %s id %d: %d\n", pCodec->name, pCodec->id, ret);
-        goto cleanup;
+        av_log(NULL, AV_LOG_VERBOSE, "  reusing open decoder %s\n", pCodec->name);
+        pooled->skip_frame = pCodecCtx->skip_frame;
+        pooled->pkt_timebase = pCodecCtx->pkt_timebase;
+        // the rest of the stream's parameters which can change on an open decoder
+        pooled->sample_aspect_ratio = pCodecCtx->sample_aspect_ratio;
+        pooled->field_order = pCodecCtx->field_order;
+        pooled->color_range = pCodecCtx->color_range;
+        pooled->color_primaries = pCodecCtx->color_primaries;
+        pooled->color_trc = pCodecCtx->color_trc;
+        pooled->colorspace = pCodecCtx->colorspace;
+        pooled->chroma_sample_location = pCodecCtx->chroma_sample_location;
+        avcodec_free_context(&pCodecCtx);
+        pCodecCtx = pooled;
+    }
+    else
+    {
+        ret = avcodec_open2(pCodecCtx, pCodec, NULL);
+        if (ret < 0)
+        {
+            av_log(NULL, AV_LOG_ERROR, "  couldn't open codec %s id %d: %d\n", pCodec->name, pCodec->id, ret);
+            goto cleanup;
+        }
     }
 
     // Allocate video frame
@@ -2272,9 +3732,11 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
     AVRational sample_aspect_ratio = av_guess_sample_aspect_ratio(pFormatCtx, pStream, NULL);
 
     double duration = (double) pFormatCtx->duration / AV_TIME_BASE; // can be unknown & can be incorrect (e.g. .vob files)
-    if (duration <= 0)
+    if (duration <= 0 && !stream_mode)
         duration = guess_duration(pFormatCtx, video_index, pCodecCtx, pFrame);
-    if (duration <= 0)
+    if (duration <= 0 && stream_mode)
+        av_log(NULL, AV_LOG_INFO, "  duration is unknown; sampling shots in a single pass\n");
+    else if (duration <= 0)
     {
         // have to turn timestamping off because it'll be incorrect
         if (o->t_timestamp)
@@ -2298,6 +3760,13 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
     int64_t start_time_tb = start_time * pStream->time_base.den / pStream->time_base.num; // in time_base unit
     //av_log(NULL, AV_LOG_ERROR, "  start_time_tb: %"PRId64"\n", start_time_tb);
 
+    // original size shots of intra-only streams are written from their packets
+    int copy_original = o->I_individual_original && !tn.rotation && !o->a_ratio_num
+        && ((pStream->codecpar->codec_id == AV_CODEC_ID_MJPEG && strcasecmp(image_extension, IMAGE_EXTENSION_JPG) == 0)
+            || (pStream->codecpar->codec_id == AV_CODEC_ID_PNG && strcasecmp(image_extension, IMAGE_EXTENSION_PNG) == 0));
+    if (copy_original && !(gb_video_pkt = av_packet_alloc()))
+        copy_original = 0;
+
     // decode the first frame without seeking.
     // without doing this, avcodec_decode_video wont be able to decode any picture
     // with some files, eg. http://download.pocketmovies.net/movies/3d/twittwit_320x184.mpg
@@ -2342,10 +3811,32 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
             sample_aspect_ratio = pCodecCtx->sample_aspect_ratio;
     }
 
+    // shots at explicit times (--at) instead of stepping
+    int nb_at = 0;
+    while (nb_at < o->at_count && (duration <= 0 || o->at_times[nb_at] < duration))
+        nb_at++;
+    if (nb_at < o->at_count)
+    {
+        av_log(NULL, AV_LOG_INFO, "  ignoring %d time(s) of --at beyond duration %.2f s\n", o->at_count - nb_at, duration);
+        if (!nb_at)
+            goto cleanup;
+    }
+    int use_reservoir = stream_mode && !nb_at;
+    // growing files keep a fixed step, so previous shots stay where they are. -I i makes no sheet to continue
+    int incremental = o->incremental && !nb_at && !stream_mode && o->s_step > 0 && !o->I_individual_ignore_grid;
+    int req_cols = nb_at ? MIN(o->c_column, nb_at) : o->c_column;
+    // rows of an incremental sheet follow the length of the file
+    int req_rows = nb_at ? (nb_at + req_cols - 1) / req_cols : incremental ? 0 : o->r_row;
+    int nb_inc = 0; // # of planned shots in incremental mode
+    if (use_reservoir && req_rows <= 0)
+        req_rows = GB_R_ROW; // # of shots can't be computed from step
+
     /* calc options */
     // FIXME: make sure values are ok when movies are very short or very small
     double net_duration;
-    if (o->C_cut > 0)
+    if (use_reservoir || duration <= 0)
+        net_duration = req_cols * req_rows + 1; // only for layout; real spacing is found while decoding
+    else if (o->C_cut > 0)
     {
         net_duration = o->C_cut;
         if (net_duration + o->B_begin > duration)
@@ -2387,12 +3878,12 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
     }
 
     reduce_shots_to_fit_in(
-        o->s_step,
-        o->r_row,
-        o->c_column,
+        nb_at || use_reservoir ? 0 : o->s_step,
+        req_rows,
+        req_cols,
         scaled_src_width_out,
         scaled_src_height_out,
-        (int) net_duration,
+        (int) (nb_at && duration > 0 ? duration : net_duration),
         &tn, o
     );
 
@@ -2416,18 +3907,17 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
         goto cleanup;
     }
 
-    if (abs(tn.rotation) == 90)
-    {
-        tn.shot_height_in = tn.shot_width_out;
-        tn.shot_width_in  = tn.shot_height_out;
-    }
-    else
+    if (nb_at)
+        tn.row = (nb_at + tn.column - 1) / tn.column; // columns might have been reduced
+    if (incremental)
     {
-        tn.shot_height_in = tn.shot_height_out;
-        tn.shot_width_in  = tn.shot_width_out;
+        // keep the requested step; the last row might not be full
+        tn.step_t = (int64_t) (o->s_step / tn.time_base);
+        nb_inc = MAX((int) (net_duration / o->s_step), 1);
+        tn.row = (nb_inc + tn.column - 1) / tn.column;
     }
 
-    if (tn.column != o->c_column)
+    if (tn.column != req_cols)
         av_log(NULL, AV_LOG_INFO, "  changing # of column to %d to meet minimum height of %d; see -h option\n", tn.column, o->h_height);
     if (o->w_width > 0 && o->w_width != tn.img_width)
         av_log(NULL, AV_LOG_INFO, "  changing width to %d to match movie's size (%dx%d)\n", tn.img_width, scaled_src_width, tn.column);
@@ -2453,9 +3943,7 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
 
     const int info_text_padding = image_string_padding(o->f_fontname, o->F_info_font_size);
 
-    if (o->i_info)
-        tn.txt_height = image_string_height(info_buf.s, o->f_fontname, o->F_info_font_size) + o->g_gap + info_text_padding;
-    tn.img_height = tn.shot_height_out*tn.row + o->g_gap*(tn.row+1) + tn.txt_height;
+    thumb_finish_layout(&tn, o->i_info ? info_buf.s : NULL, info_text_padding, o);
     av_log(NULL, AV_LOG_INFO, "  step: %.1f s; # tiles: %dx%d, tile size: %dx%d; total size: %dx%d\n",
         tn.step_t*tn.time_base, tn.column, tn.row, tn.shot_width_out, tn.shot_height_out, tn.img_width, tn.img_height);
 
@@ -2466,87 +3954,63 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
         goto cleanup;
     }
 
+    int io_budget = o->max_seeks > 0 || o->max_read_bytes > 0;
     int64_t evade_step = MIN(10 / tn.time_base, tn.step_t / 14); // max 10 s to evade blank screen
-    if (evade_step*tn.time_base <= 1)
+    if (nb_at || use_reservoir)
+        evade_step = 0; // shots are wanted at the exact times; reservoir evades by itself
+    else if (io_budget)
+        evade_step = 0; // evasions would cost seeks & reads of their own
+    else if (evade_step*tn.time_base <= 1)
     {
         evade_step = 0;
         av_log(NULL, AV_LOG_INFO, "  step is less than 14 s; blank & blur evasion is turned off.\n");
     }
 
     /* prepare for resize & conversion to AV_PIX_FMT_RGB24 */
-    pFrameRGB = av_frame_alloc();
-    if (!pFrameRGB)
+    int rgb_bufsize = alloc_rgb_frame(&pFrameRGB, &rgb_buffer, tn.shot_width_in, tn.shot_height_in);
+    if (rgb_bufsize < 0)
+        goto cleanup;
+
+    if (pyramid_open(&pyr, pCodecCtx->width, pCodecCtx->height, pCodecCtx->pix_fmt, tn.shot_width_in, tn.shot_height_in))
     {
         av_log(NULL, AV_LOG_ERROR, "  couldn't allocate a video frame\n");
         goto cleanup;
     }
-    int rgb_bufsize = av_image_get_buffer_size(AV_PIX_FMT_RGB24, tn.shot_width_in, tn.shot_height_in, LINESIZE_ALIGN);
-    rgb_buffer = av_malloc(rgb_bufsize);
-    if (!rgb_buffer)
+    if (pyr.nb_levels)
+        av_log(NULL, AV_LOG_VERBOSE, "  %dx%d frames are halved %d times to %dx%d before resizing\n",
+            pCodecCtx->width, pCodecCtx->height, pyr.nb_levels, pyr.width, pyr.height);
+    pSwsCtx = decoder_pool_get_sws(pyr.width, pyr.height, pCodecCtx->pix_fmt,
+        tn.shot_width_in, tn.shot_height_in, AV_PIX_FMT_RGB24, o->sws_flags);
+    if (!pSwsCtx)
     {
-        av_log(NULL, AV_LOG_ERROR, "  av_malloc %d bytes failed\n", rgb_bufsize);
+        av_log(NULL, AV_LOG_ERROR, "  sws_getContext failed\n");
         goto cleanup;
     }
-    // Returns: the size in bytes required for src, a negative error code in case of failure
-    ret = av_image_fill_arrays(pFrameRGB->data, pFrameRGB->linesize, rgb_buffer, AV_PIX_FMT_RGB24, tn.shot_width_in, tn.shot_height_in, LINESIZE_ALIGN);
-    if (ret < 0)
+    // -v shows the edges found in the rgb shots instead
+    if ((evade_step > 0 || use_reservoir) && !o->v_verbose
+        && gray_shot_open(&gray, pyr.width, pyr.height, pCodecCtx->pix_fmt, tn.shot_width_in, tn.shot_height_in, o->sws_flags))
     {
-        av_log(NULL, AV_LOG_ERROR, "  av_image_fill_arrays failed (%d)\n", ret);
+        av_log(NULL, AV_LOG_ERROR, "  sws_getContext failed\n");
         goto cleanup;
     }
 
-    pSwsCtx = sws_getContext(pCodecCtx->width, pCodecCtx->height, pCodecCtx->pix_fmt,
-        tn.shot_width_in, tn.shot_height_in, AV_PIX_FMT_RGB24, SWS_BILINEAR, NULL, NULL, NULL);
-    if (!pSwsCtx)
-    {
-        av_log(NULL, AV_LOG_ERROR, "  sws_getContext failed\n");
+    /* timestamp glyphs are rasterized once per batch */
+    int timestamp_text_padding = 0;
+    if (t_timestamp && !(ts_glyphs = open_timestamp_glyphs(&timestamp_text_padding, o)))
         goto cleanup;
-    }
 
     /* create the output image */
-    tn.out_ip = gdImageCreateTrueColor(tn.img_width, tn.img_height);
-    if (!tn.out_ip)
-    {
-        av_log(NULL, AV_LOG_ERROR, "  gdImageCreateTrueColor failed: width %d, height %d\n", tn.img_width, tn.img_height);
+    int background;
+    if (thumb_create_canvas(&tn, info_buf.s, info_text_padding, &background, o))
         goto cleanup;
-    }
 
     if (o->webvtt)
         sprite = sprite_create(o->w_width, tn.shot_width_in, tn.shot_height_out, &tn);
-    
-    /* setting alpha blending is not needed, using default mode:
-     * https://libgd.github.io/manuals/2.2.5/files/gd-h.html#Effects
-    gdImageAlphaBlending(tn.out_ip,	
-        //gdEffectReplace		//replace pixels
-        gdEffectAlphaBlend	   	//blend pixels, see gdAlphaBlend
-        //gdEffectNormal		//default mode; same as gdEffectAlphaBlend
-        //gdEffectOverlay		//overlay pixels, see gdLayerOverlay
-        //gdEffectMultiply	//overlay pixels with multiply effect, see gdLayerMultiply
-    );
-    */
-    int background = gdImageColorResolve(tn.out_ip, RGB_R(o->k_bcolor), RGB_G(o->k_bcolor), RGB_B(o->k_bcolor)); // set backgroud
-    gdImageFilledRectangle(tn.out_ip, 0, 0, tn.img_width, tn.img_height, background);
-
-    if (o->transparent_bg)
-        gdImageColorTransparent(tn.out_ip, background);
-
-    /* add info & text */ // do this early so when font is not found we'll quit early
-    if (info_buf.len)
-    {
-        char *error = image_string(tn.out_ip,
-            o->f_fontname, o->F_info_color, o->F_info_font_size,
-            o->L_info_location, o->g_gap, info_buf.s, 0, COLOR_WHITE, info_text_padding);
-        if (error)
-        {
-            av_log(NULL, AV_LOG_ERROR, "  %s; font problem? see -f option\n", error);
-            goto cleanup;
-        }
-    }
 
     /* if needed create shadow image used for every shot	*/
     if (o->shadow >= 0)
     {
-        thumbShadowIm = create_shadow_image(background, tn.shot_width_out, tn.shot_height_out, &shadow_radius, o);
+        thumbShadowIm = get_shadow_image(background, tn.shot_width_out, tn.shot_height_out, &shadow_radius, &shadow_key, o);
         if (!thumbShadowIm)
             goto cleanup;
     }
@@ -2558,6 +4022,19 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
         goto cleanup;
     }
 
+    /* shots go straight into their tiles when nothing else needs a separate image of them */
+    // evasion looks at the gray shots; -v stamps the edges & scores into the shots
+    int direct_tiles = !use_reservoir && (evade_step == 0 || gray.pSwsCtx)
+        && !o->webvtt && !o->I_individual && !o->v_verbose;
+#ifdef DEBUG_IMAGES
+    direct_tiles = 0;
+#endif
+    if (direct_tiles && tile_scaler_open(&tiles, &tn, pyr.width, pyr.height, pCodecCtx->pix_fmt, o->sws_flags))
+    {
+        av_log(NULL, AV_LOG_ERROR, "  preparing direct tiles failed\n");
+        goto cleanup;
+    }
+
     if (o->z_seek)
         seek_mode = 1;
     if (o->Z_nonseek)
@@ -2565,25 +4042,136 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
         seek_mode = 0;
         av_log(NULL, AV_LOG_INFO, "  *** using non-seek mode -- slower but more accurate timing.\n");
     }
+    if (stream_mode)
+        seek_mode = 0;
+
+    if (use_reservoir)
+    {
+        if (o->I_individual_original)
+            av_log(NULL, AV_LOG_INFO, "  original size shots (-I o) are not supported for non-seekable input\n");
+        if (reservoir_alloc(&rsv, 2 * tn.row * tn.column, rgb_bufsize) == -1)
+        {
+            av_log(NULL, AV_LOG_ERROR, "  reservoir_alloc failed\n");
+            goto cleanup;
+        }
+        rsv.origin = first_pts + (int64_t) (o->B_begin / tn.time_base);
+        rsv.interval = MAX((int64_t) (1 / tn.time_base), 1);
+        int blank_evasion = o->b_blank <= 1 && tn.row * tn.column > 1;
+        if (!stream_collect(pFormatCtx, pCodecCtx, pFrame, video_index, pSwsCtx, &pyr, &gray, pFrameRGB, blank_evasion, &tn, &rsv, o))
+        {
+            av_log(NULL, AV_LOG_ERROR, "  no shots found in a single pass\n");
+            goto cleanup;
+        }
+    }
+
+    /* plan seek targets & map them to their key frames */
+    if (shot_plan_alloc(&plan, use_reservoir ? MIN(rsv.count, tn.row * tn.column) : nb_at ? nb_at : nb_inc ? nb_inc : tn.row * tn.column) == -1)
+    {
+        av_log(NULL, AV_LOG_ERROR, "  shot_plan_alloc failed\n");
+        goto cleanup;
+    }
+    if (use_reservoir)
+    {
+        int i;
+        for (i = 0; i < plan.nb_targets; i++)
+            plan.targets[i] = rsv.pts[reservoir_pick(&rsv, i, plan.nb_targets)];
+        tn.step_t = rsv.interval * rsv.count / plan.nb_targets;
+    }
+    else if (nb_at)
+    {
+        int i;
+        for (i = 0; i < nb_at; i++)
+            plan.targets[i] = (int64_t) ((start_time + o->at_times[i]) / tn.time_base);
+    }
+    else
+        shot_plan_fill_steps(&plan, tn.step_t + (int64_t) ((start_time + o->B_begin) / tn.time_base), tn.step_t);
+    shot_plan_map_keyframes(&plan, pStream);
+    if (seek_mode && plan.nb_seeks < plan.nb_targets)
+        av_log(NULL, AV_LOG_INFO, "  %d shots share key frames; seeking %d times\n", plan.nb_targets - plan.nb_seeks, plan.nb_seeks);
+    if (seek_mode && !rsv.count && shot_plan_limit_seeks(&plan, o->max_seeks) > 0)
+        av_log(NULL, AV_LOG_INFO, "  seek budget is %d; other shots are taken from the next key frame\n", o->max_seeks);
+    int nb_io_seeks = 0; // seeks done in the shot loop
+    int prefetch = seek_mode && !rsv.count && li.pb;
+
+    /* continue after shots of the previous run */
+    if (incremental)
+    {
+        sb_add_buffer(&inc_filename, &tn.out_filename);
+        sb_add_string(&inc_filename, INC_STATE_SUFFIX);
+        if (inc_state_load(&inc, inc_filename.s) == 0)
+        {
+            if (inc.tb_num != pStream->time_base.num || inc.tb_den != pStream->time_base.den
+                || inc.first_target != plan.targets[0] || inc.step_t != tn.step_t
+                || inc.tile_w != tn.shot_width_out || inc.tile_h != tn.shot_height_out
+                || inc.nb_targets > plan.nb_targets)
+            {
+                av_log(NULL, AV_LOG_INFO, "  %s doesn't match current options; starting over\n", inc_filename.s);
+                inc_state_free(&inc);
+            }
+            else if (sprite && inc.sprite_file_idx && sprite_load_vtt(sprite))
+            {
+                av_log(NULL, AV_LOG_INFO, "  previous .vtt file not found; starting over\n");
+                inc_state_free(&inc);
+            }
+            else
+                av_log(NULL, AV_LOG_INFO, "  continuing after %d shots of previous run\n", inc.nb_targets);
+        }
+        int i;
+        for (i = 0; i < inc.nb_tiles; i++)
+        {
+            gdImagePtr tile = inc_state_get_tile(&inc, i);
+            if (!tile)
+            {
+                av_log(NULL, AV_LOG_ERROR, "  inc_state_get_tile failed\n");
+                goto cleanup;
+            }
+            thumb_add_shot(&tn, tile, thumbShadowIm, shadow_radius, i, inc.pts[i], o);
+            gdImageDestroy(tile);
+        }
+        if (sprite)
+        {
+            sprite->curr_file_idx = inc.sprite_file_idx; // new shots go to new chunks
+            sprite->last_shot_pts = inc.sprite_last_pts;
+        }
+    }
 
     int64_t seek_target, seek_evade; // in time_base unit
+    int target_idx; // index of seek_target in plan
+    int64_t decoder_pts = first_pts; // pts of the last packet sent to decoder; AV_NOPTS_VALUE after flush
+
+    // non-seek mode still skips what the previous run has decoded
+    if (!seek_mode && inc.nb_targets > 0 && inc.nb_targets < plan.nb_targets
+        && really_seek(pFormatCtx, video_index, plan.targets[inc.nb_targets], duration) >= 0)
+    {
+        avcodec_flush_buffers(pCodecCtx);
+        decoder_pts = AV_NOPTS_VALUE;
+    }
 
     /* decode & fill in the shots */
   restart:
     seek_target = 0, seek_evade = 0; // in time_base unit
+    local_input_set_sequential(&li, !seek_mode);
     if (!seek_mode && o->B_begin > 10)
         av_log(NULL, AV_LOG_INFO, "  -B %.2f with non-seek mode will take some time.\n", o->B_begin);
 
     int evade_try = 0; // blank screen evasion index
     double avg_evade_try = 0; // average
-    seek_target = tn.step_t + (int64_t) ((start_time + o->B_begin) / tn.time_base);
-    idx = 0; // idx = thumb_idx
-    thumb_nb = tn.row * tn.column; // thumb_nb = # of shots we need
-    int64_t prevshot_pts = -1; // pts of previous good shot
-    int64_t prevfound_pts = -1; // pts of previous decoding
+    int nb_approx = 0; // # of shots away from their target because of the I/O budget
+    target_idx = inc.nb_targets; // 0 unless continuing an incremental run
+    seek_target = target_idx < plan.nb_targets ? plan.targets[target_idx] : 0;
+    if (prefetch)
+    {
+        int i;
+        for (i = 0; i < PREFETCH_SHOTS; i++)
+            prefetch_shot(&li, pStream, &plan, target_idx + i);
+    }
+    idx = inc.nb_tiles; // idx = thumb_idx
+    thumb_nb = plan.nb_targets - (inc.nb_targets - inc.nb_tiles); // thumb_nb = # of shots we need
+    int64_t prevshot_pts = inc.nb_tiles ? inc.pts[inc.nb_tiles - 1] : -1; // pts of previous good shot
+    int64_t prevfound_pts = prevshot_pts; // pts of previous decoding
     gdImagePtr edge_ip = NULL; // edge image
 
-    for (idx = 0; idx < thumb_nb; idx++)
+    for (idx = inc.nb_tiles; idx < thumb_nb; idx++)
     {
         int64_t eff_target = seek_target + seek_evade; // effective target
         eff_target = MAX(eff_target, start_time_tb); // make sure eff_target > start_time
@@ -2591,7 +4179,9 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
         format_time(calc_time(eff_target, pStream->time_base, start_time), time_str, sizeof(time_str), ':');
 
         /* for some formats, previous seek might over shoot pass this seek_target; is this a bug in libavcodec? */
-        if (prevshot_pts > eff_target && !evade_try)
+        // with an I/O budget, late shots are kept; catching up would cost seeks.
+        // --at times are never dropped: a time before the previous shot gets the frame after it
+        if (prevshot_pts > eff_target && !evade_try && !io_budget && !nb_at)
         {
             // restart in seek mode of skipping shots (FIXME)
             if (seek_mode && !o->z_seek)
@@ -2599,6 +4189,7 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
                 av_log(NULL, AV_LOG_INFO, "  *** previous seek overshot target %s; switching to non-seek mode\n", time_str);
                 av_seek_frame(pFormatCtx, video_index, 0, 0);
                 avcodec_flush_buffers(pCodecCtx);
+                decoder_pts = AV_NOPTS_VALUE;
                 seek_mode = 0;
                 goto restart;
             }
@@ -2611,13 +4202,36 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
         // make sure eff_target > previous found
         eff_target = MAX(eff_target, prevfound_pts+1);
 
+        /* over the I/O budget: take the next key frame (seeks) or the next frame (bytes) without seeking */
+        int approximated = 0;
+        if (!rsv.count && target_idx < plan.nb_targets)
+        {
+            int over_bytes = o->max_read_bytes > 0 && pFormatCtx->pb
+                && pFormatCtx->pb->bytes_read >= o->max_read_bytes;
+            if (over_bytes || (seek_mode && plan.approx[target_idx]))
+            {
+                int64_t key = over_bytes ? AV_NOPTS_VALUE : shot_plan_next_keyframe(pStream, prevfound_pts);
+                eff_target = key != AV_NOPTS_VALUE ? MAX(key, prevfound_pts+1) : prevfound_pts+1;
+                approximated = 1;
+            }
+        }
+
         format_time(calc_time(eff_target, pStream->time_base, start_time), time_str, sizeof(time_str), ':');
         av_log(NULL, AV_LOG_VERBOSE, "\n***eff_target tb: %"PRId64", eff_target s:%.2f (%s), prevshot_pts: %"PRId64"\n", 
             eff_target, calc_time(eff_target, pStream->time_base, start_time), time_str, prevshot_pts);
 
         /* jump to next shot */
-        if (seek_mode)
+        if (rsv.count)
         {
+            // decoded & scaled in a single pass
+            int c = reservoir_pick(&rsv, target_idx, plan.nb_targets);
+            found_pts = rsv.pts[c];
+            av_image_fill_arrays(pFrameRGB->data, pFrameRGB->linesize, rsv.rgb[c], AV_PIX_FMT_RGB24, tn.shot_width_in, tn.shot_height_in, LINESIZE_ALIGN);
+        }
+        // targets (evasions too) in the GOP being decoded are reached without seeking
+        else if (seek_mode && !approximated && !shot_plan_in_gop(pStream, decoder_pts, eff_target))
+        {
+            nb_io_seeks++;
             ret = really_seek(pFormatCtx, video_index, eff_target, duration);
             if (ret < 0)
             {
@@ -2637,7 +4251,7 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
         }
         else
         {
-            // non-seek mode -- we keep decoding until we get to the next shot
+            // non-seek mode or same GOP -- we keep decoding until we get to the next shot
             found_pts = 0;
             while (found_pts < eff_target)
             {
@@ -2660,7 +4274,7 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
         int64_t found_diff = found_pts - eff_target;
         //av_log(NULL, AV_LOG_INFO, "  found_diff: %.2f\n", found_diff); // DEBUG
         // if found frame is too far off from target, we'll disable seeking and start over
-        if (idx < 5 && seek_mode && !o->z_seek 
+        if (idx < 5 && seek_mode && !o->z_seek && !io_budget
             // usually movies have key frames every 10 s
             && (tn.step_t < (15/tn.time_base) || found_diff > 15/tn.time_base)
             && (found_diff <= -tn.step_t || found_diff >= tn.step_t))
@@ -2682,12 +4296,22 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
             // disable seeking and start over
             av_seek_frame(pFormatCtx, video_index, 0, 0);
             avcodec_flush_buffers(pCodecCtx);
+            decoder_pts = AV_NOPTS_VALUE;
             seek_mode = 0;
             av_log(NULL, AV_LOG_INFO, "  *** switching to non-seek mode because seeking was off target by %.2f s.\n", found_diff*tn.time_base);
             av_log(NULL, AV_LOG_INFO, "  non-seek mode is slower. increase time step or use -z if you don't want this.\n");
             goto restart;
         }
       non_seek_too_long:
+        decoder_pts = found_pts;
+        if (approximated)
+        {
+            char found_str[64];
+            format_time(calc_time(seek_target, pStream->time_base, start_time), time_str, sizeof(time_str), ':');
+            format_time(calc_time(found_pts, pStream->time_base, start_time), found_str, sizeof(found_str), ':');
+            av_log(NULL, AV_LOG_INFO, "  shot %d approximated: wanted %s, got %s\n", idx, time_str, found_str);
+            nb_approx++;
+        }
 
         nb_shots++;
         av_log(NULL, AV_LOG_VERBOSE, "shot %d: found_: %"PRId64" (%.2fs), eff_: %"PRId64" (%.2fs), dtime: %.3f\n", 
@@ -2710,18 +4334,44 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
             goto skip_shot;
         }
 
+        const AVFrame *pScaleFrame = rsv.count ? pFrame : pyramid_reduce(&pyr, pFrame);
+
+        /* if blank screen, try again */
+        // FIXME: make sure this'll work when step is small
+        // FIXME: make sure each shot wont get repeated
+        double blank = 0;
+        // only do edge when blank detection doesn't work
+        double edge[EDGE_PARTS] = {1,1,1,1,1,1}; // FIXME: change this if EDGE_PARTS is changed
+        // on the luma, so rejected frames aren't converted to rgb
+        int gray_checked = evade_step > 0 && !rsv.count && gray.pSwsCtx;
+        if (gray_checked)
+        {
+            if (gray_shot_scale(&gray, pScaleFrame, pyr.height))
+            {
+                av_log(NULL, AV_LOG_ERROR, "  sws_scale() failed\n");
+                goto cleanup;
+            }
+            blank = blank_plane(gray.data, gray.width, gray.height);
+            if (blank <= o->b_blank && o->D_edge > 0)
+                detect_edge_gray(gray.data, gray.width, gray.height, edge, EDGE_FOUND, o);
+        }
+
         /* convert to AV_PIX_FMT_RGB24 & resize */
-        int output_height; //the height of the output slice
-        output_height = sws_scale(pSwsCtx, (const uint8_t* const*)pFrame->data, pFrame->linesize, 0, pCodecCtx->height,
-            pFrameRGB->data, pFrameRGB->linesize);
-        if (output_height <= 0)
+        // direct tiles are scaled once they're accepted
+        if (!rsv.count && !direct_tiles && (!gray_checked || (blank <= o->b_blank && is_edge(edge, EDGE_FOUND))))
         {
-            av_log(NULL, AV_LOG_ERROR, "  sws_scale() failed\n");
-            goto cleanup;
+            int output_height; //the height of the output slice
+            output_height = sws_scale(pSwsCtx, (const uint8_t* const*)pScaleFrame->data, pScaleFrame->linesize, 0, pyr.height,
+                pFrameRGB->data, pFrameRGB->linesize);
+            if (output_height <= 0)
+            {
+                av_log(NULL, AV_LOG_ERROR, "  sws_scale() failed\n");
+                goto cleanup;
+            }
         }
 
         pFrameRGB->width = tn.shot_width_in;
-        pFrameRGB->height = output_height;
+        pFrameRGB->height = tn.shot_height_in;
         pFrameRGB->format = AV_PIX_FMT_RGB24;
 
 #ifdef DEBUG_IMAGES
@@ -2729,16 +4379,14 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
         save_AVFrame(pFrameRGB, debug_filename, pFrameRGB->width, pFrameRGB->height, o);
 #endif
 
-        /* if blank screen, try again */
-        // FIXME: make sure this'll work when step is small
-        // FIXME: make sure each shot wont get repeated
-        double blank = blank_frame(pFrameRGB, tn.shot_width_out, tn.shot_height_out);
-        // only do edge when blank detection doesn't work
-        double edge[EDGE_PARTS] = {1,1,1,1,1,1}; // FIXME: change this if EDGE_PARTS is changed
-        if (evade_step > 0 && blank <= o->b_blank && o->D_edge > 0)
-            edge_ip = rotate_gdImage(
-                detect_edge(pFrameRGB, &tn, edge, EDGE_FOUND, o),
-                tn.rotation);
+        if (!gray_checked && !direct_tiles)
+        {
+            blank = blank_frame(pFrameRGB, tn.shot_width_out, tn.shot_height_out);
+            if (evade_step > 0 && blank <= o->b_blank && o->D_edge > 0)
+                edge_ip = rotate_gdImage(
+                    detect_edge(pFrameRGB, &tn, edge, EDGE_FOUND, o),
+                    tn.rotation);
+        }
 
         //av_log(NULL, AV_LOG_INFO, "  idx: %d, evade_try: %d, blank: %.2f%s edge: %.3f %.3f %.3f %.3f %.3f %.3f%s\n", 
         //    idx, evade_try, blank, (blank > o->b_blank) ? "**b**" : "", 
@@ -2769,6 +4417,44 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
         avg_evade_try = (avg_evade_try * idx + evade_try ) / (idx+1); // DEBUG
         //av_log(NULL, AV_LOG_VERBOSE, "  *** avg_evade_try: %.2f\n", avg_evade_try); // DEBUG
 
+        /* resize & timestamp straight into the output image */
+        if (direct_tiles)
+        {
+            ret = thumb_scale_shot(&tn, &tiles, pScaleFrame, pyr.height,
+                thumbShadowIm, shadow_radius, idx, found_pts, o);
+            if (ret < 0)
+            {
+                av_log(NULL, AV_LOG_ERROR, "  sws_scale() failed\n");
+                goto cleanup;
+            }
+            if (ret == 0)
+            {
+                if (t_timestamp)
+                {
+                    int dstX, dstY;
+                    thumb_shot_position(&tn, idx, &dstX, &dstY, o);
+                    char time_str[64];
+                    format_time(calc_time(found_pts, pStream->time_base, start_time), time_str, sizeof(time_str), ':');
+                    char *str_ret = image_glyphs_rect(tn.out_ip, dstX, dstY, tn.shot_width_out, tn.shot_height_out,
+                        ts_glyphs, o->F_ts_color, o->L_time_location, 0, time_str, 1, o->F_ts_shadow,
+                        timestamp_text_padding);
+                    if (str_ret)
+                    {
+                        av_log(NULL, AV_LOG_ERROR, "  %s; font problem? see -f option or -F option\n", str_ret);
+                        goto cleanup;
+                    }
+                }
+                goto skip_shot;
+            }
+            // the tile isn't inside the output image; copied with clipping below
+            if (sws_scale(pSwsCtx, (const uint8_t* const*)pScaleFrame->data, pScaleFrame->linesize, 0, pyr.height,
+                pFrameRGB->data, pFrameRGB->linesize) <= 0)
+            {
+                av_log(NULL, AV_LOG_ERROR, "  sws_scale() failed\n");
+                goto cleanup;
+            }
+        }
+
         /* convert to GD image */
         ip = gdImageCreateTrueColor(tn.shot_width_in, tn.shot_height_in);
         if (!ip)
@@ -2790,17 +4476,14 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
         if (o->webvtt)
             sprite_add_shot(sprite, ip, found_pts, o);
 
-        const int timestamp_text_padding = image_string_padding(o->F_ts_fontname, o->F_ts_font_size);
-
         /* timestamping */
         // FIXME: this frame might not actually be at the requested position. is pts correct?
         if (t_timestamp)
         {
             char time_str[64];
             format_time(calc_time(found_pts, pStream->time_base, start_time), time_str, sizeof(time_str), ':');
-            char *str_ret = image_string(ip, 
-                o->F_ts_fontname, o->F_ts_color, o->F_ts_font_size, 
-                o->L_time_location, 0, time_str, 1, o->F_ts_shadow, timestamp_text_padding);
+            char *str_ret = image_glyphs_rect(ip, 0, 0, gdImageSX(ip), gdImageSY(ip), ts_glyphs,
+                o->F_ts_color, o->L_time_location, 0, time_str, 1, o->F_ts_shadow, timestamp_text_padding);
             if (str_ret)
             {
                 av_log(NULL, AV_LOG_ERROR, "  %s; font problem? see -f option or -F option\n", str_ret);
@@ -2837,12 +4520,20 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
                 sb_shrink(&individual_filename, tn.base_filename.len);
             }
 
-            if (o->I_individual_original)
+            if (o->I_individual_original && !rsv.count)
             {
                 sb_add_string_len(&individual_filename, "_o_", 3);
                 sb_add_string(&individual_filename, time_str);
                 sb_add_string_len(&individual_filename, index_buf, index_len);
-                if (save_AVFrame(pFrame, individual_filename.s, pFrame->width, pFrame->height, o))
+                int copied = 0;
+                if (copy_original && gb_video_pkt->size
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(55, 34, 100)
+                    && gb_video_pkt->pts == pFrame->pts) // decoder might have delayed the frame
+#else
+                    && gb_video_pkt->pts == pFrame->pkt_pts)
+#endif
+                    copied = !save_packet_image(gb_video_pkt, pStream->codecpar, individual_filename.s);
+                if (!copied && save_AVFrame(pFrame, individual_filename.s, pFrame->width, pFrame->height, o))
                     av_log(NULL, AV_LOG_ERROR, "  saving individual shot #%05d to %s failed\n", idx, individual_filename.s);
                 sb_shrink(&individual_filename, tn.base_filename.len);
             }
@@ -2857,8 +4548,11 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
 
       skip_shot:
         /* step */
-        seek_target += tn.step_t;
-        
+        if (++target_idx < plan.nb_targets)
+            seek_target = plan.targets[target_idx];
+        if (prefetch)
+            prefetch_shot(&li, pStream, &plan, target_idx + PREFETCH_SHOTS - 1);
+
         seek_evade = 0;
         evade_try = 0;
         prevshot_pts = found_pts;
@@ -2874,6 +4568,11 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
     }
     av_log(NULL, AV_LOG_VERBOSE, "  *** avg_evade_try: %.2f\n", avg_evade_try); // DEBUG
 
+  eof:
+    if (io_budget)
+        av_log(NULL, AV_LOG_INFO, "  I/O: %d seeks, %"PRId64" bytes read; %d of %d shots approximated\n",
+            nb_io_seeks, pFormatCtx->pb ? pFormatCtx->pb->bytes_read : 0, nb_approx, idx);
+    // sprite chunks & cues are kept on end of file too, e.g. growing recordings
     sprite_flush(sprite, o);
     sprite_export_vtt(sprite);
 
@@ -2883,7 +4582,6 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
         goto cleanup;
     }
 
-  eof: ;
     /* crop if we dont get enough shots */
     int crop_needed = 0;
     const int created_rows = (int) ceil((double)idx / tn.column);
@@ -2932,13 +4630,17 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
     else
         goto cleanup;
 
+    if (incremental && save_inc_state(&inc, &tn, sprite, pStream->time_base, plan.targets[0],
+            MIN(target_idx, plan.nb_targets), inc_filename.s, o))
+        av_log(NULL, AV_LOG_ERROR, "  saving incremental state to %s failed\n", inc_filename.s);
+
     int64_t tfinish = get_current_time();
     double diff_time = diff_time_sec(tstart, tfinish);
     // previous version reported # of decoded shots/s; now we report the # of final shots/s
     av_log(NULL, AV_LOG_INFO, "  %.2f s, %.2f shots/s; output: %s\n",
         diff_time, (tn.idx + 1) / diff_time, tn.out_filename.s);
 
-    if (tn.tiles_nr == tn.row * tn.column)
+    if (tn.tiles_nr == tn.row * tn.column || tn.tiles_nr == plan.nb_targets)
         return_code = 0; // everything is fine
     else
         return_code = 1; // warning - some images are missing
@@ -2947,30 +4649,33 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
     if (ip)
         gdImageDestroy(ip);
     if (thumbShadowIm)
-        gdImageDestroy(thumbShadowIm);
+        render_cache_put_shadow(thumbShadowIm, &shadow_key, shadow_radius);
     if (tn.out_ip)
         gdImageDestroy(tn.out_ip);
 
     if (info_fp)
     {
         fclose(info_fp);
-        if (!o->I_individual_ignore_grid && !tn.out_saved)
+        if (!o->I_individual_ignore_grid && !o->metadata_only && !tn.out_saved)
             delete_file(info_filename);
     }
 
-    if (pSwsCtx)
-        sws_freeContext(pSwsCtx); // do we need to do this?
-
     // Free the video frame
     if (rgb_buffer)
         av_free(rgb_buffer);
     if (pFrameRGB)
         av_free(pFrameRGB);
+    tile_scaler_free(&tiles);
+    gray_shot_free(&gray);
+    pyramid_free(&pyr);
     if (pFrame)
         av_free(pFrame);
+    av_packet_free(&gb_video_pkt);
 
-    // Close the codec
-    if (pCodecCtx)
+    // Close the codec; one of a file which was decoded cleanly is kept for the next file
+    if (pCodecCtx && return_code == 0 && gb_decode_errors == decode_errors && avcodec_is_open(pCodecCtx))
+        decoder_pool_put(pCodecCtx, &dec_key);
+    else if (pCodecCtx)
     {
         avcodec_close(pCodecCtx);
         avcodec_free_context(&pCodecCtx);
@@ -2979,8 +4684,15 @@ int make_thumbnail(const char *file, const struct options *o, int nb_file)
     // Close the video file
     if (pFormatCtx)
         avformat_close_input(&pFormatCtx);
+    local_input_close(&li);
+    http_cache_close(&hc);
 
     thumb_cleanup_dynamic(&tn);
+    shot_plan_free(&plan);
+    reservoir_free(&rsv);
+    inc_state_free(&inc);
+    sb_destroy(&inc_filename);
+    free(archive_name);
     sprite_destroy(sprite);
     sb_destroy(&info_buf);
     sb_destroy(&individual_filename);
@@ -3041,19 +4753,77 @@ struct process_state
     int processed;
     int errors;
     int all_extensions;
+    char *pending[PROBE_POOL_MAX + 1]; // files waiting while the probe pool opens them
+    int nb_pending;
 };
 
+static void process_next(struct process_state *ps)
+{
+    char *file = ps->pending[0];
+    ps->nb_pending--;
+    memmove(ps->pending, ps->pending + 1, ps->nb_pending * sizeof(*ps->pending));
+    if (make_thumbnail(file, &ps->opt, ++ps->nb_file))
+        ps->errors++;
+    ps->processed++;
+    probe_pool_discard(gb_probe_pool, file); // e.g. omitted because its output exists
+    free(file);
+}
+
+/*
+make thumbnails of file, or queue it while the next files are probed ahead
+*/
+static void process_file(struct process_state *ps, const char *file)
+{
+    char *copy = strdup(file);
+    if (!copy)
+    {
+        av_log(NULL, AV_LOG_ERROR, "\n%s: strdup failed\n", gb_argv0);
+        ps->errors++;
+        return;
+    }
+    ps->pending[ps->nb_pending++] = copy;
+    if (gb_probe_pool && can_probe_ahead(file, &ps->opt))
+        probe_pool_submit(gb_probe_pool, file);
+    if (ps->nb_pending > (gb_probe_pool ? ps->opt.prefetch : 0))
+        process_next(ps);
+}
+
 static void process_dir_func(void *context, const tchar_t *path)
 {
     struct process_state *ps = (struct process_state *) context;
     const char *converted_path = tchar_to_utf8(path);
     if (ps->all_extensions || check_extension(converted_path))
+        process_file(ps, converted_path);
+    free_conv_result(converted_path);
+}
+
+/*
+make thumbnails of the movies stored in archive file
+*/
+static void process_archive(struct process_state *ps, const char *file)
+{
+    struct archive a;
+    if (archive_open(&a, file))
     {
-        if (make_thumbnail(converted_path, &ps->opt, ++ps->nb_file))
-            ps->errors++;
-        ps->processed++;
+        av_log(NULL, AV_LOG_ERROR, "\n%s: reading archive %s failed\n", gb_argv0, file);
+        ps->errors++;
+        return;
     }
-    free_conv_result(converted_path);
+    struct string_buffer member;
+    sb_init(&member);
+    int i;
+    for (i = 0; i < a.nb_members; i++)
+    {
+        if (!check_extension(a.members[i].name))
+            continue;
+        sb_clear(&member);
+        sb_add_string(&member, file);
+        sb_add_char(&member, ARCHIVE_SEPARATOR);
+        sb_add_string(&member, a.members[i].name);
+        process_file(ps, member.s);
+    }
+    sb_destroy(&member);
+    archive_free(&a);
 }
 
 void process_files(struct process_state *ps, char *paths[], int count)
@@ -3084,10 +4854,15 @@ void process_files(struct process_state *ps, char *paths[], int count)
             }
             else
 #endif
-                make_thumbnail(paths[i], &ps->opt, ++ps->nb_file);
+            if (archive_has_extension(paths[i]) && is_reg(path))
+                process_archive(ps, paths[i]);
+            else
+                process_file(ps, paths[i]);
         }
         free_conv_result(path);
     }
+    while (ps->nb_pending)
+        process_next(ps);
 }
 
 /*
@@ -3144,7 +4919,7 @@ int main(int argc, char *argv[])
 
     /* get & check options */
     struct process_state ps;
-    ps.nb_file = ps.processed = ps.errors = 0;
+    ps.nb_file = ps.processed = ps.errors = ps.nb_pending = 0;
     init_options(&ps.opt);
     
     int start_index;
@@ -3199,12 +4974,23 @@ int main(int argc, char *argv[])
     char *ident = mtn_identification();
     av_log(NULL, AV_LOG_VERBOSE, "%s\n\n", ident);
     free(ident);
+    pixel_ops_init();
+    av_log(NULL, AV_LOG_VERBOSE, "pixel kernels: %s\n", pixel_ops_name());
         
     //gdUseFontConfig(1); // set GD to use fontconfig patterns
 
     /* process movie files */
     V_DEBUG = ps.opt.V;
+    // --all-video-streams opens files itself
+    if (ps.opt.prefetch > 0 && !ps.opt.all_video_streams && argc - start_index > 0)
+        gb_probe_pool = probe_pool_create(ps.opt.prefetch, probe_ahead, &ps.opt);
     process_files(&ps, argv + start_index, argc - start_index);
+    probe_pool_free(gb_probe_pool);
+    gb_probe_pool = NULL;
+    decoder_pool_free();
+    render_cache_free();
+    archive_free(&gb_archive);
+    free(gb_archive_file);
 
   exit:
     // clean up
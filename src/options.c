@@ -1,6 +1,13 @@
 #include "options.h"
+#include "file_utils.h"
+#include "http_cache.h"
+#include "local_input.h"
+#include "probe_pool.h"
+#include <errno.h>
+#include <math.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <libavutil/avutil.h>
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
@@ -67,6 +74,19 @@ void init_options(struct options *o)
     o->cover_suffix = strdup("_cover.jpg");
     o->webvtt_prefix = strdup("");
     o->dict = NULL;
+    o->at_times = NULL;
+    o->at_count = 0;
+    o->incremental = 0;
+    o->metadata_only = 0;
+    o->all_video_streams = 0;
+    o->io_buffer = 0; // opt-in; the local input drops what it read from the page cache
+    o->mmap = 0;
+    o->http_cache = NULL;
+    o->http_cache_size = HTTP_CACHE_SIZE;
+    o->max_seeks = 0;
+    o->max_read_bytes = 0;
+    o->prefetch = PROBE_POOL_FILES;
+    o->sws_flags = SWS_BICUBIC;
 }
 
 static int get_location_opt(struct options *o, char c, char *optarg)
@@ -246,6 +266,127 @@ static int get_opt_for_I_arg(struct options *o, const char *optarg)
     return 0;
 }
 
+/*
+convert [[HH:]MM:]SS[.fraction] to seconds; fields are decimal digits and
+minutes & seconds after the leading field are below 60
+return -1 if error
+*/
+static int parse_time(const char *str, double *seconds)
+{
+    double value = 0;
+    int fields = 0;
+    while (1)
+    {
+        // built from the digits; strtod() would follow the decimal point of the locale
+        const char *p = str;
+        double field = 0;
+        while (*p >= '0' && *p <= '9')
+            field = field * 10 + (*p++ - '0');
+        if (p == str || ++fields > 3)
+            return -1;
+        if (*p == '.')
+        {
+            const char *fraction = ++p;
+            double scale = 1;
+            while (*p >= '0' && *p <= '9')
+            {
+                scale /= 10;
+                field += (*p++ - '0') * scale;
+            }
+            if (p == fraction || *p)
+                return -1; // only the last field can have a fraction
+        }
+        if (fields > 1 && field >= 60)
+            return -1;
+        value = value * 60 + field;
+        if (*p == 0)
+            break;
+        if (*p != ':')
+            return -1;
+        str = p + 1;
+    }
+    if (!isfinite(value))
+        return -1; // too many digits
+    *seconds = value;
+    return 0;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double da = *(const double *) a;
+    double db = *(const double *) b;
+    return (da > db) - (da < db);
+}
+
+static int add_at_times(struct options *o, char *list, const char *source)
+{
+    const char *delim = ", \t\r\n";
+    char *token = strtok(list, delim);
+    while (token)
+    {
+        double seconds;
+        if (parse_time(token, &seconds))
+        {
+            av_log(NULL, AV_LOG_ERROR, "%s: invalid time '%s' in %s -- must be [[HH:]MM:]SS[.ms]\n", gb_argv0, token, source);
+            return 1;
+        }
+        double *times = realloc(o->at_times, (o->at_count + 1) * sizeof(*times));
+        if (!times)
+        {
+            av_log(NULL, AV_LOG_ERROR, "%s: realloc failed\n", gb_argv0);
+            return 1;
+        }
+        o->at_times = times;
+        o->at_times[o->at_count++] = seconds;
+        token = strtok(NULL, delim);
+    }
+    return 0;
+}
+
+/*
+--at=list or --at=@file; list of times separated by commas or white spaces
+*/
+static int get_at_opt(struct options *o, char *optarg)
+{
+    if (*optarg != '@')
+        return add_at_times(o, optarg, "--at");
+
+    const char *filename = optarg + 1;
+    const tchar_t *tname = utf8_to_tchar(filename);
+    FILE *fp = _tfopen(tname, _T("r"));
+    free_conv_result(tname);
+    if (!fp)
+    {
+        av_log(NULL, AV_LOG_ERROR, "%s: opening time list '%s' failed: %s\n", gb_argv0, filename, strerror(errno));
+        return 1;
+    }
+    int ret = 0;
+    char line[1024];
+    while (!ret && fgets(line, sizeof(line), fp))
+    {
+        if (line[0] == '#')
+            continue;
+        ret = add_at_times(o, line, filename);
+    }
+    fclose(fp);
+    return ret;
+}
+
+/*
+sort --at times & remove duplicates
+*/
+static void sort_at_times(struct options *o)
+{
+    if (o->at_count < 2)
+        return;
+    qsort(o->at_times, o->at_count, sizeof(*o->at_times), cmp_double);
+    int i, n = 1;
+    for (i = 1; i < o->at_count; i++)
+        if (o->at_times[i] != o->at_times[n-1])
+            o->at_times[n++] = o->at_times[i];
+    o->at_count = n;
+}
+
 static int get_int_opt(char *optname, int *opt, char *optarg, int sign)
 {
     char *tailptr;
@@ -269,6 +410,64 @@ static int get_int_opt(char *optname, int *opt, char *optarg, int sign)
     return 0;
 }
 
+/*
+size in bytes with optional suffix k, M or G (powers of 1024)
+*/
+static int get_size_opt(char *optname, int64_t *opt, char *optarg)
+{
+    char *tailptr;
+    double ret = strtod(optarg, &tailptr);
+    switch (*tailptr)
+    {
+    case 'k': case 'K': ret *= 1024; tailptr++; break;
+    case 'm': case 'M': ret *= 1024 * 1024; tailptr++; break;
+    case 'g': case 'G': ret *= 1024 * 1024 * 1024; tailptr++; break;
+    }
+    if (*tailptr)
+    {
+        av_log(NULL, AV_LOG_ERROR, "%s: argument for option -%s is invalid at '%s'\n", gb_argv0, optname, tailptr);
+        return 1;
+    }
+    if (ret < 0 || ret > INT64_MAX / 2)
+    {
+        av_log(NULL, AV_LOG_ERROR, "%s: argument for option -%s is out of range\n", gb_argv0, optname);
+        return 1;
+    }
+    *opt = (int64_t) ret;
+    return 0;
+}
+
+/*
+swscale filters of --scaler
+*/
+static const struct
+{
+    const char *name;
+    int flags;
+} gb_scalers[] =
+{
+    { "fast_bilinear", SWS_FAST_BILINEAR },
+    { "bilinear", SWS_BILINEAR },
+    { "bicubic", SWS_BICUBIC },
+    { "area", SWS_AREA },
+    { "gauss", SWS_GAUSS },
+    { "lanczos", SWS_LANCZOS },
+    { "spline", SWS_SPLINE },
+};
+
+static int get_scaler_opt(struct options *o, char *optarg)
+{
+    int i;
+    for (i = 0; i < (int) (sizeof(gb_scalers) / sizeof(*gb_scalers)); i++)
+        if (!strcmp(optarg, gb_scalers[i].name))
+        {
+            o->sws_flags = gb_scalers[i].flags;
+            return 0;
+        }
+    av_log(NULL, AV_LOG_ERROR, "%s: unknown scaler '%s'\n", gb_argv0, optarg);
+    return 1;
+}
+
 static int get_double_opt(char c, double *opt, char *optarg, double sign)
 {
     char *tailptr;
@@ -365,8 +564,20 @@ void usage()
     av_log(NULL, AV_LOG_INFO, "  --transparent\n       set background color (-k) to transparent; works with PNG image only \n");
     av_log(NULL, AV_LOG_INFO, "  --cover[=_cover.jpg]\n       extract album art if exists \n");
     av_log(NULL, AV_LOG_INFO, "  --vtt[=path in .vtt]\n       export WebVTT file and sprite chunks\n");
+    av_log(NULL, AV_LOG_INFO, "  --at=times\n       take shots at the given times instead of stepping (-s, -r); times are [[HH:]MM:]SS[.ms] separated by \",\", or @file with times on separate lines\n");
+    av_log(NULL, AV_LOG_INFO, "  --incremental\n       for files which are still growing (e.g. recordings); keep shots in a state file next to the output and only decode the new part of the file on the next run. uses fixed step (-s); -r is ignored unless incremental mode is off (no -s, -I i or stream input)\n");
+    av_log(NULL, AV_LOG_INFO, "  --metadata-only\n       only save info text (-N) and album art (--cover) without decoding; no thumbnail is created\n");
+    av_log(NULL, AV_LOG_INFO, "  --all-video-streams\n       create a sheet for each video stream (e.g. multi-angle or multi-camera files) named <movie>_s<stream index><suffix>; the file is read only once. -S, --at, --incremental, -N, --metadata-only, -I & --vtt are not supported\n");
+    av_log(NULL, AV_LOG_INFO, "  --io-buffer=KiB\n       read local files with a KiB buffer (default: 0 = FFmpeg's file protocol; %d with --mmap); upcoming shots are read ahead in seek mode & data already read is dropped from the page cache in long sequential reads\n", LOCAL_INPUT_BUFFER_SIZE);
+    av_log(NULL, AV_LOG_INFO, "  --mmap\n       map local files into memory instead of reading them; fast for files on SSD or in page cache. the file must not be truncated while it's processed\n");
+    av_log(NULL, AV_LOG_INFO, "  --http-cache=dir\n       keep blocks read from http(s) inputs in dir, so later seeks & runs read them from disk\n");
+    av_log(NULL, AV_LOG_INFO, "  --http-cache-size=MiB\n       size of --http-cache (default: %d); least recently used blocks are removed\n", HTTP_CACHE_SIZE);
+    av_log(NULL, AV_LOG_INFO, "  --max-seeks=N\n       seek at most N times per file; other shots are taken from the next key frame without seeking and reported as approximated\n");
+    av_log(NULL, AV_LOG_INFO, "  --max-read-bytes=size[k|M|G]\n       read at most about size bytes per file; when it's reached, the remaining shots are taken from the next frames\n");
+    av_log(NULL, AV_LOG_INFO, "  --prefetch=N\n       open & probe the next N files of a batch while the current one is processed (default: %d); 0:off\n", PROBE_POOL_FILES);
+    av_log(NULL, AV_LOG_INFO, "  --scaler=name\n       filter of the last resize step: fast_bilinear, bilinear, bicubic, area, gauss, lanczos or spline (default: bicubic). big movies (e.g. 4K) are halved by averaging 2x2 pixels first, until they are less than 4 times the size of the shots\n");
     av_log(NULL, AV_LOG_INFO, "  --options=option_entries\n       list of options passed to the FFmpeg library. option_entries contains list of options separated by \"|\". Each option contains name and value separated by \":\".\n");
-    av_log(NULL, AV_LOG_INFO, "  file_or_dirX\n       name of the movie file or directory containing movie files\n\n");
+    av_log(NULL, AV_LOG_INFO, "  file_or_dirX\n       name of the movie file or directory containing movie files\n       - reads the movie from standard input in a single pass\n       bundle.tar#inner/clip.mp4 reads a member of an uncompressed .tar or .zip (stored) archive in place; movies in an archive given as file are all processed\n\n");
 #ifdef _WIN32
     av_log(NULL, AV_LOG_INFO, "Examples:\n");
     av_log(NULL, AV_LOG_INFO, "  to save thumbnails to file infile%s with default options:\n    %s infile.avi\n", GB_O_SUFFIX, gb_argv0);
@@ -379,6 +590,7 @@ void usage()
     av_log(NULL, AV_LOG_INFO, "  to draw shadows of the individual shots, try:\n    %s --shadow=3 -g 7 infile.avi\n", gb_argv0);
     av_log(NULL, AV_LOG_INFO, "  to export thumbnails in WebVTT format every 10 seconds and max size of 1920x1920px:\n    %s -s 10 -w 1920 --vtt=/var/www/html/ -O /mnt/fileshare -Ii -o .jpg infile.avi\n", gb_argv0);
     av_log(NULL, AV_LOG_INFO, "  to skip warning messages to be printed to console (useful for flv files producing lot of warnings), try:\n    %s -q infile.avi\n", gb_argv0);
+    av_log(NULL, AV_LOG_INFO, "  to save individual shots at chapter marks:\n    %s --at=1:03,12:40,1:02:05.5 -It infile.avi\n", gb_argv0);
     av_log(NULL, AV_LOG_INFO, "  to enable additional protocols:\n    %s --options=protocol_whitelist:file,crypto,data,http,https,tcp,tls infile.avi\n", gb_argv0);
     av_log(NULL, AV_LOG_INFO, "\nIn windows, you can run %s from command prompt or drag files/dirs from\n", gb_argv0);
     av_log(NULL, AV_LOG_INFO, "windows explorer and drop them on %s. you can change the default options\n", gb_argv0);
@@ -425,6 +637,18 @@ int parse_options(struct options *o, int argc, char *argv[], int *start_index)
         { "cover",       optional_argument, 0, 0 },
         { "vtt",         optional_argument, 0, 0 },
         { "options",     required_argument, 0, 0 },
+        { "at",          required_argument, 0, 0 },
+        { "incremental", no_argument,       0, 0 },
+        { "metadata-only", no_argument,     0, 0 },
+        { "all-video-streams", no_argument, 0, 0 },
+        { "io-buffer",   required_argument, 0, 0 },
+        { "mmap",        no_argument,       0, 0 },
+        { "http-cache",  required_argument, 0, 0 },
+        { "http-cache-size", required_argument, 0, 0 },
+        { "max-seeks",   required_argument, 0, 0 },
+        { "max-read-bytes", required_argument, 0, 0 },
+        { "prefetch",    required_argument, 0, 0 },
+        { "scaler",      required_argument, 0, 0 },
         { 0,             0,                 0, 0 }
     };
     int parse_error = 0, option_index = 0;
@@ -465,6 +689,53 @@ int parse_options(struct options *o, int argc, char *argv[], int *start_index)
                     if (options_to_AVDictionary(o, optarg) != 0)
                         parse_error++;
                     break;
+                case 5: // at
+                    parse_error += get_at_opt(o, optarg);
+                    break;
+                case 6: // incremental
+                    o->incremental = 1;
+                    break;
+                case 7: // metadata-only
+                    o->metadata_only = 1;
+                    break;
+                case 8: // all-video-streams
+                    o->all_video_streams = 1;
+                    break;
+                case 9: // io-buffer
+                    parse_error += get_int_opt("-io-buffer", &o->io_buffer, optarg, 0);
+                    if (o->io_buffer > 1024 * 1024)
+                    {
+                        av_log(NULL, AV_LOG_ERROR, "%s: argument for option --io-buffer must be <= %d\n", gb_argv0, 1024 * 1024);
+                        parse_error++;
+                    }
+                    break;
+                case 10: // mmap
+                    o->mmap = 1;
+                    break;
+                case 11: // http-cache
+                    free((char *) o->http_cache);
+                    o->http_cache = strdup(optarg);
+                    break;
+                case 12: // http-cache-size
+                    parse_error += get_int_opt("-http-cache-size", &o->http_cache_size, optarg, 1);
+                    break;
+                case 13: // max-seeks
+                    parse_error += get_int_opt("-max-seeks", &o->max_seeks, optarg, 0);
+                    break;
+                case 14: // max-read-bytes
+                    parse_error += get_size_opt("-max-read-bytes", &o->max_read_bytes, optarg);
+                    break;
+                case 15: // prefetch
+                    parse_error += get_int_opt("-prefetch", &o->prefetch, optarg, 0);
+                    if (o->prefetch > PROBE_POOL_MAX)
+                    {
+                        av_log(NULL, AV_LOG_ERROR, "%s: argument for option --prefetch must be <= %d\n", gb_argv0, PROBE_POOL_MAX);
+                        parse_error++;
+                    }
+                    break;
+                case 16: // scaler
+                    parse_error += get_scaler_opt(o, optarg);
+                    break;
             }
             break;
         case 'a':
@@ -654,6 +925,20 @@ int parse_options(struct options *o, int argc, char *argv[], int *start_index)
         av_log(NULL, AV_LOG_ERROR, "%s: option -C and -E can't be used together", gb_argv0);
         parse_error++;
     }
+    if (o->incremental && o->at_count)
+    {
+        av_log(NULL, AV_LOG_ERROR, "%s: option --incremental and --at can't be used together", gb_argv0);
+        parse_error++;
+    }
+    if (o->all_video_streams && (o->at_count || o->incremental || o->S_select_video_stream != GB_S_SELECT_VIDEO_STREAM
+        || (o->N_suffix && *o->N_suffix) || o->metadata_only))
+    {
+        av_log(NULL, AV_LOG_ERROR, "%s: option --all-video-streams can't be used with -S, --at, --incremental, -N or --metadata-only", gb_argv0);
+        parse_error++;
+    }
+    if (o->mmap && o->io_buffer == 0)
+        o->io_buffer = LOCAL_INPUT_BUFFER_SIZE; // mapped files are read through the local input
+    sort_at_times(o);
     *start_index = optind;
     return parse_error;
 }
@@ -667,6 +952,8 @@ void free_options(struct options *o)
     free((char *) o->O_outdir);
     free((char *) o->cover_suffix);
     free((char *) o->webvtt_prefix);
+    free((char *) o->http_cache);
     if (o->dict)
         av_dict_free(&o->dict);
+    free(o->at_times);
 }
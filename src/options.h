@@ -112,6 +112,19 @@ struct options
     const char *cover_suffix;
     const char *webvtt_prefix;
     AVDictionary *dict;
+    double *at_times; // shot times in seconds, sorted & unique; overrides -s & -r
+    int at_count;
+    int incremental; // continue thumbnail of a growing file from the previous run
+    int metadata_only; // only info text (-N) & album art (--cover); no thumbnail
+    int all_video_streams; // one sheet per video stream from a single pass
+    int io_buffer; // in KiB; buffer of local files; 0 = default file protocol
+    int mmap; // map local files instead of reading them
+    const char *http_cache; // directory of the block cache of http(s) inputs; NULL = off
+    int http_cache_size; // in MiB
+    int max_seeks; // seek budget per file; 0 = unlimited
+    int64_t max_read_bytes; // read budget per file; 0 = unlimited
+    int prefetch; // # of files opened & probed ahead in batches; 0 = off
+    int sws_flags; // filter of swscale's resize, e.g. SWS_BICUBIC
 };
 
 char* mtn_identification();
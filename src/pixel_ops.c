@@ -0,0 +1,511 @@
+#include "pixel_ops.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavutil/cpu.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PIXEL_OPS_X86 1
+#include <immintrin.h>
+// gcc & clang only allow the intrinsics in functions built for the target
+#if defined(__GNUC__)
+#define TARGET(t) __attribute__((target(t)))
+#else
+#define TARGET(t)
+#endif
+#elif defined(__ARM_NEON) && (!defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define PIXEL_OPS_NEON 1
+#include <arm_neon.h>
+#endif
+
+static void rgb24_to_truecolor_row_c(int *dst, const uint8_t *src, int width)
+{
+    int x;
+    for (x = 0; x < width; x++, src += 3)
+        dst[x] = src[0] << 16 | src[1] << 8 | src[2];
+}
+
+#ifdef PIXEL_OPS_X86
+// r g b of 4 pixels to little endian 0x00RRGGBB
+#define RGB24_SHUFFLE 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1
+
+TARGET("ssse3")
+static void rgb24_to_truecolor_row_ssse3(int *dst, const uint8_t *src, int width)
+{
+    const __m128i shuffle = _mm_setr_epi8(RGB24_SHUFFLE);
+    int x = 0;
+    // each load takes 16 bytes for 4 pixels (12 bytes); keep it inside the row
+    for (; x + 10 <= width; x += 8, src += 24)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *) src);
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + 12));
+        _mm_storeu_si128((__m128i *) (dst + x), _mm_shuffle_epi8(a, shuffle));
+        _mm_storeu_si128((__m128i *) (dst + x + 4), _mm_shuffle_epi8(b, shuffle));
+    }
+    rgb24_to_truecolor_row_c(dst + x, src, width - x);
+}
+
+TARGET("avx2")
+static void rgb24_to_truecolor_row_avx2(int *dst, const uint8_t *src, int width)
+{
+    const __m256i shuffle = _mm256_setr_epi8(RGB24_SHUFFLE, RGB24_SHUFFLE);
+    int x = 0;
+    // 4 pixels in each 128-bit lane, shuffled within the lane
+    for (; x + 18 <= width; x += 16, src += 48)
+    {
+        __m256i a = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) src)),
+            _mm_loadu_si128((const __m128i *) (src + 12)), 1);
+        __m256i b = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (src + 24))),
+            _mm_loadu_si128((const __m128i *) (src + 36)), 1);
+        _mm256_storeu_si256((__m256i *) (dst + x), _mm256_shuffle_epi8(a, shuffle));
+        _mm256_storeu_si256((__m256i *) (dst + x + 8), _mm256_shuffle_epi8(b, shuffle));
+    }
+    rgb24_to_truecolor_row_c(dst + x, src, width - x);
+}
+#endif
+
+#ifdef PIXEL_OPS_NEON
+static void rgb24_to_truecolor_row_neon(int *dst, const uint8_t *src, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16, src += 48)
+    {
+        uint8x16x3_t rgb = vld3q_u8(src);
+        uint8x16x4_t bgra;
+        bgra.val[0] = rgb.val[2];
+        bgra.val[1] = rgb.val[1];
+        bgra.val[2] = rgb.val[0];
+        bgra.val[3] = vdupq_n_u8(0);
+        vst4q_u8((uint8_t *) (dst + x), bgra);
+    }
+    rgb24_to_truecolor_row_c(dst + x, src, width - x);
+}
+#endif
+
+static void box_halve_row_c(uint8_t *dst, const uint8_t *src0, const uint8_t *src1, int width)
+{
+    int x;
+    for (x = 0; x < width; x++, src0 += 2, src1 += 2)
+        dst[x] = (src0[0] + src0[1] + src1[0] + src1[1] + 2) >> 2;
+}
+
+#ifdef PIXEL_OPS_X86
+TARGET("ssse3")
+static void box_halve_row_ssse3(uint8_t *dst, const uint8_t *src0, const uint8_t *src1, int width)
+{
+    const __m128i ones = _mm_set1_epi8(1);
+    const __m128i two = _mm_set1_epi16(2);
+    int x = 0;
+    for (; x + 16 <= width; x += 16, src0 += 32, src1 += 32)
+    {
+        // horizontal pairs summed to 16 bits, then the vertical ones
+        __m128i lo = _mm_add_epi16(_mm_maddubs_epi16(_mm_loadu_si128((const __m128i *) src0), ones),
+            _mm_maddubs_epi16(_mm_loadu_si128((const __m128i *) src1), ones));
+        __m128i hi = _mm_add_epi16(_mm_maddubs_epi16(_mm_loadu_si128((const __m128i *) (src0 + 16)), ones),
+            _mm_maddubs_epi16(_mm_loadu_si128((const __m128i *) (src1 + 16)), ones));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+        _mm_storeu_si128((__m128i *) (dst + x), _mm_packus_epi16(lo, hi));
+    }
+    box_halve_row_c(dst + x, src0, src1, width - x);
+}
+
+TARGET("avx2")
+static void box_halve_row_avx2(uint8_t *dst, const uint8_t *src0, const uint8_t *src1, int width)
+{
+    const __m256i ones = _mm256_set1_epi8(1);
+    const __m256i two = _mm256_set1_epi16(2);
+    int x = 0;
+    for (; x + 32 <= width; x += 32, src0 += 64, src1 += 64)
+    {
+        __m256i lo = _mm256_add_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i *) src0), ones),
+            _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i *) src1), ones));
+        __m256i hi = _mm256_add_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i *) (src0 + 32)), ones),
+            _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i *) (src1 + 32)), ones));
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, two), 2);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, two), 2);
+        // packus works within 128-bit lanes; put the 4 quarters back in order
+        _mm256_storeu_si256((__m256i *) (dst + x), _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8));
+    }
+    box_halve_row_c(dst + x, src0, src1, width - x);
+}
+#endif
+
+#ifdef PIXEL_OPS_NEON
+static void box_halve_row_neon(uint8_t *dst, const uint8_t *src0, const uint8_t *src1, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16, src0 += 32, src1 += 32)
+    {
+        uint16x8_t lo = vaddq_u16(vpaddlq_u8(vld1q_u8(src0)), vpaddlq_u8(vld1q_u8(src1)));
+        uint16x8_t hi = vaddq_u16(vpaddlq_u8(vld1q_u8(src0 + 16)), vpaddlq_u8(vld1q_u8(src1 + 16)));
+        // rounding shift: (sum + 2) >> 2
+        vst1q_u8(dst + x, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+    }
+    box_halve_row_c(dst + x, src0, src1, width - x);
+}
+#endif
+
+void (*box_halve_row)(uint8_t *dst, const uint8_t *src0, const uint8_t *src1, int width) = box_halve_row_c;
+
+static int count_same_bytes_c(const uint8_t *pa, const uint8_t *pb, const uint8_t *pc, int n)
+{
+    int i, same = 0;
+    for (i = 0; i < n; i++)
+    {
+        int diffab = pa[i] - pb[i];
+        int diffac = pa[i] - pc[i];
+        int diffbc = pb[i] - pc[i];
+
+        if (abs(diffab) < SAME_DIFF && abs(diffac) < SAME_DIFF && abs(diffbc) < SAME_DIFF)
+            same++;
+    }
+    return same;
+}
+
+#ifdef PIXEL_OPS_X86
+// |a - b| of unsigned bytes
+#define ABSDIFF_EPU8(a, b) _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a))
+#define ABSDIFF_EPU8_256(a, b) _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a))
+
+TARGET("sse2")
+static int count_same_bytes_sse2(const uint8_t *pa, const uint8_t *pb, const uint8_t *pc, int n)
+{
+    const __m128i limit = _mm_set1_epi8(SAME_DIFF - 1);
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i sum = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *) (pa + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (pb + i));
+        __m128i c = _mm_loadu_si128((const __m128i *) (pc + i));
+        __m128i d = _mm_max_epu8(ABSDIFF_EPU8(a, b), _mm_max_epu8(ABSDIFF_EPU8(a, c), ABSDIFF_EPU8(b, c)));
+        // largest difference <= SAME_DIFF - 1: 0xff -> 1, counted by the sum of absolute differences to 0
+        __m128i same = _mm_and_si128(_mm_cmpeq_epi8(_mm_min_epu8(d, limit), d), one);
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(same, _mm_setzero_si128()));
+    }
+    return _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sum, sum))
+        + count_same_bytes_c(pa + i, pb + i, pc + i, n - i);
+}
+
+TARGET("avx2")
+static int count_same_bytes_avx2(const uint8_t *pa, const uint8_t *pb, const uint8_t *pc, int n)
+{
+    const __m256i limit = _mm256_set1_epi8(SAME_DIFF - 1);
+    const __m256i one = _mm256_set1_epi8(1);
+    __m256i sum = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (pa + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (pb + i));
+        __m256i c = _mm256_loadu_si256((const __m256i *) (pc + i));
+        __m256i d = _mm256_max_epu8(ABSDIFF_EPU8_256(a, b), _mm256_max_epu8(ABSDIFF_EPU8_256(a, c), ABSDIFF_EPU8_256(b, c)));
+        __m256i same = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(d, limit), d), one);
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(same, _mm256_setzero_si256()));
+    }
+    __m128i sum128 = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    return _mm_cvtsi128_si32(sum128) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sum128, sum128))
+        + count_same_bytes_c(pa + i, pb + i, pc + i, n - i);
+}
+#endif
+
+#ifdef PIXEL_OPS_NEON
+static int count_same_bytes_neon(const uint8_t *pa, const uint8_t *pb, const uint8_t *pc, int n)
+{
+    const uint8x16_t limit = vdupq_n_u8(SAME_DIFF);
+    uint32x4_t sum = vdupq_n_u32(0);
+    int i = 0;
+    while (i + 16 <= n)
+    {
+        // each 16-bit lane gets at most 2 per 16 bytes
+        uint16x8_t part = vdupq_n_u16(0);
+        int end = i + 16 * 16384 < n ? i + 16 * 16384 : n;
+        for (; i + 16 <= end; i += 16)
+        {
+            uint8x16_t a = vld1q_u8(pa + i);
+            uint8x16_t b = vld1q_u8(pb + i);
+            uint8x16_t c = vld1q_u8(pc + i);
+            uint8x16_t d = vmaxq_u8(vabdq_u8(a, b), vmaxq_u8(vabdq_u8(a, c), vabdq_u8(b, c)));
+            part = vpadalq_u8(part, vshrq_n_u8(vcltq_u8(d, limit), 7));
+        }
+        sum = vpadalq_u16(sum, part);
+    }
+    uint64x2_t sum64 = vpaddlq_u32(sum);
+    return (int) (vgetq_lane_u64(sum64, 0) + vgetq_lane_u64(sum64, 1))
+        + count_same_bytes_c(pa + i, pb + i, pc + i, n - i);
+}
+#endif
+
+int (*count_same_bytes)(const uint8_t *pa, const uint8_t *pb, const uint8_t *pc, int n) = count_same_bytes_c;
+
+// laplacian of n pixels of row; row[-1] & row[n] are read
+static int count_edges_inner_c(const uint8_t *up, const uint8_t *row, const uint8_t *down, int n, int threshold)
+{
+    int x, count = 0;
+    for (x = 0; x < n; x++)
+        count += 4 * row[x] - up[x] - down[x] - row[x - 1] - row[x + 1] >= threshold;
+    return count;
+}
+
+#ifdef PIXEL_OPS_X86
+// 4 * c - (l + r + u + d) of 8 pixels, widened to 16 bits
+#define LAPLACIAN_EPI16(unpack, c, l, r, u, d, zero) _mm_sub_epi16(_mm_slli_epi16(unpack(c, zero), 2), \
+    _mm_add_epi16(_mm_add_epi16(unpack(l, zero), unpack(r, zero)), _mm_add_epi16(unpack(u, zero), unpack(d, zero))))
+#define LAPLACIAN_EPI16_256(unpack, c, l, r, u, d, zero) _mm256_sub_epi16(_mm256_slli_epi16(unpack(c, zero), 2), \
+    _mm256_add_epi16(_mm256_add_epi16(unpack(l, zero), unpack(r, zero)), _mm256_add_epi16(unpack(u, zero), unpack(d, zero))))
+
+TARGET("sse2")
+static int count_edges_inner_sse2(const uint8_t *up, const uint8_t *row, const uint8_t *down, int n, int threshold)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i limit = _mm_set1_epi16((short) (threshold - 1));
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i sum = zero;
+    int x = 0;
+    for (; x + 16 <= n; x += 16)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *) (row + x));
+        __m128i l = _mm_loadu_si128((const __m128i *) (row + x - 1));
+        __m128i r = _mm_loadu_si128((const __m128i *) (row + x + 1));
+        __m128i u = _mm_loadu_si128((const __m128i *) (up + x));
+        __m128i d = _mm_loadu_si128((const __m128i *) (down + x));
+        __m128i lo = _mm_cmpgt_epi16(LAPLACIAN_EPI16(_mm_unpacklo_epi8, c, l, r, u, d, zero), limit);
+        __m128i hi = _mm_cmpgt_epi16(LAPLACIAN_EPI16(_mm_unpackhi_epi8, c, l, r, u, d, zero), limit);
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_and_si128(_mm_packs_epi16(lo, hi), one), zero));
+    }
+    return _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sum, sum))
+        + count_edges_inner_c(up + x, row + x, down + x, n - x, threshold);
+}
+
+TARGET("avx2")
+static int count_edges_inner_avx2(const uint8_t *up, const uint8_t *row, const uint8_t *down, int n, int threshold)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i limit = _mm256_set1_epi16((short) (threshold - 1));
+    const __m256i one = _mm256_set1_epi8(1);
+    __m256i sum = zero;
+    int x = 0;
+    for (; x + 32 <= n; x += 32)
+    {
+        __m256i c = _mm256_loadu_si256((const __m256i *) (row + x));
+        __m256i l = _mm256_loadu_si256((const __m256i *) (row + x - 1));
+        __m256i r = _mm256_loadu_si256((const __m256i *) (row + x + 1));
+        __m256i u = _mm256_loadu_si256((const __m256i *) (up + x));
+        __m256i d = _mm256_loadu_si256((const __m256i *) (down + x));
+        // the order of pixels within the lanes doesn't matter for counting
+        __m256i lo = _mm256_cmpgt_epi16(LAPLACIAN_EPI16_256(_mm256_unpacklo_epi8, c, l, r, u, d, zero), limit);
+        __m256i hi = _mm256_cmpgt_epi16(LAPLACIAN_EPI16_256(_mm256_unpackhi_epi8, c, l, r, u, d, zero), limit);
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(_mm256_and_si256(_mm256_packs_epi16(lo, hi), one), zero));
+    }
+    __m128i sum128 = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    return _mm_cvtsi128_si32(sum128) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sum128, sum128))
+        + count_edges_inner_c(up + x, row + x, down + x, n - x, threshold);
+}
+#endif
+
+#ifdef PIXEL_OPS_NEON
+static int count_edges_inner_neon(const uint8_t *up, const uint8_t *row, const uint8_t *down, int n, int threshold)
+{
+    const int16x8_t limit = vdupq_n_s16((int16_t) threshold);
+    uint32x4_t sum = vdupq_n_u32(0);
+    int x = 0;
+    for (; x + 8 <= n; x += 8)
+    {
+        uint16x8_t c4 = vshll_n_u8(vld1_u8(row + x), 2);
+        uint16x8_t around = vaddq_u16(vaddl_u8(vld1_u8(row + x - 1), vld1_u8(row + x + 1)),
+            vaddl_u8(vld1_u8(up + x), vld1_u8(down + x)));
+        int16x8_t lap = vreinterpretq_s16_u16(vsubq_u16(c4, around));
+        sum = vpadalq_u16(sum, vshrq_n_u16(vcgeq_s16(lap, limit), 15));
+    }
+    uint64x2_t sum64 = vpaddlq_u32(sum);
+    return (int) (vgetq_lane_u64(sum64, 0) + vgetq_lane_u64(sum64, 1))
+        + count_edges_inner_c(up + x, row + x, down + x, n - x, threshold);
+}
+#endif
+
+static int (*count_edges_inner)(const uint8_t *up, const uint8_t *row, const uint8_t *down, int n, int threshold) = count_edges_inner_c;
+
+/*
+return # of pixels x in [xbegin, xend] of a width pixels row with
+4 * row[x] - up[x] - down[x] - row[x-1] - row[x+1] >= threshold, i.e. the
+laplacian of edge detection; the first & last pixel stand in for the ones
+beyond the ends of the row
+*/
+int count_edges(const uint8_t *up, const uint8_t *row, const uint8_t *down, int width, int xbegin, int xend,
+    int threshold)
+{
+    int count = 0;
+    if (xbegin > xend)
+        return 0;
+    if (xbegin == 0)
+    {
+        count += 4 * row[0] - up[0] - down[0] - row[0] - row[width > 1] >= threshold;
+        xbegin++;
+    }
+    if (xend == width - 1 && xend >= xbegin)
+    {
+        count += 4 * row[xend] - up[xend] - down[xend] - row[xend - 1] - row[xend] >= threshold;
+        xend--;
+    }
+    if (xend >= xbegin)
+        count += count_edges_inner(up + xbegin, row + xbegin, down + xbegin, xend - xbegin + 1, threshold);
+    return count;
+}
+
+/*
+halve a src_width x src_height 8-bit plane into dst, averaging 2x2 blocks.
+dst is (src_width + 1) / 2 x (src_height + 1) / 2; an odd last column or
+row is averaged with itself.
+*/
+void box_halve_plane(uint8_t *dst, int dst_linesize, const uint8_t *src, int src_linesize,
+    int src_width, int src_height)
+{
+    int dst_width = (src_width + 1) / 2;
+    int dst_height = (src_height + 1) / 2;
+    int y;
+    for (y = 0; y < dst_height; y++, dst += dst_linesize)
+    {
+        const uint8_t *src0 = src + (ptrdiff_t) 2 * y * src_linesize;
+        const uint8_t *src1 = 2 * y + 1 < src_height ? src0 + src_linesize : src0;
+        box_halve_row(dst, src0, src1, src_width / 2);
+        if (src_width & 1)
+        {
+            int last = src_width - 1;
+            dst[dst_width - 1] = (2 * src0[last] + 2 * src1[last] + 2) >> 2;
+        }
+    }
+}
+
+/*
+rotate width x height pixels of the src rows into the dst rows starting at
+column dst_x; the rotated block is height x width for +-90 degrees. angle
+is counter-clockwise like av_display_rotation_get(): 90 turns the top row
+into the left column. pixels are moved in square blocks, so neither the
+rows read nor the rows written fall out of the cache.
+return -1 if angle isn't a multiple of 90
+*/
+int rotate_pixels(int *const *dst, int dst_x, const int *const *src, int width, int height, int angle)
+{
+    int bx, by, x, y;
+    switch (angle)
+    {
+    case 0:
+        for (y = 0; y < height; y++)
+            memcpy(dst[y] + dst_x, src[y], width * sizeof(int));
+        return 0;
+    case 180:
+    case -180:
+        // rows stay rows; no blocking needed
+        for (y = 0; y < height; y++)
+        {
+            const int *s = src[y];
+            int *d = dst[height - 1 - y] + dst_x + width - 1;
+            for (x = 0; x < width; x++)
+                d[-x] = s[x];
+        }
+        return 0;
+    case 90:
+    case -90:
+        break;
+    default:
+        return -1;
+    }
+    for (by = 0; by < height; by += ROTATE_BLOCK)
+    {
+        int ye = by + ROTATE_BLOCK < height ? by + ROTATE_BLOCK : height;
+        for (bx = 0; bx < width; bx += ROTATE_BLOCK)
+        {
+            int xe = bx + ROTATE_BLOCK < width ? bx + ROTATE_BLOCK : width;
+            if (angle == 90)
+            {
+                for (x = bx; x < xe; x++)
+                {
+                    int *d = dst[width - 1 - x] + dst_x;
+                    for (y = by; y < ye; y++)
+                        d[y] = src[y][x];
+                }
+            }
+            else
+            {
+                for (x = bx; x < xe; x++)
+                {
+                    int *d = dst[x] + dst_x + height - 1;
+                    for (y = by; y < ye; y++)
+                        d[-y] = src[y][x];
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+swscale fills the unused byte of AV_PIX_FMT_0RGB32 with 0xFF, which gd reads
+as transparent (alpha 0x7F); gdImageCopy() would drop such pixels
+*/
+void opaque_pixels(int *const *rows, int x, int width, int height)
+{
+    int i, y;
+    for (y = 0; y < height; y++)
+    {
+        int *p = rows[y] + x;
+        for (i = 0; i < width; i++)
+            p[i] &= 0x00FFFFFF;
+    }
+}
+
+void (*rgb24_to_truecolor_row)(int *dst, const uint8_t *src, int width) = rgb24_to_truecolor_row_c;
+static const char *gb_pixel_ops_name = "c";
+
+/*
+choose the kernels for this cpu; av_force_cpu_flags() is respected
+*/
+void pixel_ops_init(void)
+{
+    int flags = av_get_cpu_flags();
+    (void) flags;
+    rgb24_to_truecolor_row = rgb24_to_truecolor_row_c;
+    box_halve_row = box_halve_row_c;
+    count_same_bytes = count_same_bytes_c;
+    count_edges_inner = count_edges_inner_c;
+    gb_pixel_ops_name = "c";
+#ifdef PIXEL_OPS_X86
+    if (flags & AV_CPU_FLAG_SSE2)
+    {
+        count_same_bytes = count_same_bytes_sse2;
+        count_edges_inner = count_edges_inner_sse2;
+        gb_pixel_ops_name = "sse2";
+    }
+    if (flags & AV_CPU_FLAG_SSSE3)
+    {
+        rgb24_to_truecolor_row = rgb24_to_truecolor_row_ssse3;
+        box_halve_row = box_halve_row_ssse3;
+        gb_pixel_ops_name = "ssse3";
+    }
+    if (flags & AV_CPU_FLAG_AVX2)
+    {
+        rgb24_to_truecolor_row = rgb24_to_truecolor_row_avx2;
+        box_halve_row = box_halve_row_avx2;
+        count_same_bytes = count_same_bytes_avx2;
+        count_edges_inner = count_edges_inner_avx2;
+        gb_pixel_ops_name = "avx2";
+    }
+#endif
+#ifdef PIXEL_OPS_NEON
+    if (flags & AV_CPU_FLAG_NEON)
+    {
+        rgb24_to_truecolor_row = rgb24_to_truecolor_row_neon;
+        box_halve_row = box_halve_row_neon;
+        count_same_bytes = count_same_bytes_neon;
+        count_edges_inner = count_edges_inner_neon;
+        gb_pixel_ops_name = "neon";
+    }
+#endif
+}
+
+const char *pixel_ops_name(void)
+{
+    return gb_pixel_ops_name;
+}
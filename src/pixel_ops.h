@@ -0,0 +1,39 @@
+#ifndef PIXEL_OPS_H_
+#define PIXEL_OPS_H_
+
+#include <stdint.h>
+
+/*
+row kernels for the per-pixel work on shots, with sse/avx2/neon versions
+chosen at run time from av_get_cpu_flags(). every version gives exactly
+the same result as the plain c one.
+*/
+
+/* rgb24 row to gd truecolor pixels (ip->tpixels[y]), alpha opaque */
+extern void (*rgb24_to_truecolor_row)(int *dst, const uint8_t *src, int width);
+
+/* dst[x] = rounded average of src0 & src1 [2x, 2x+1] */
+extern void (*box_halve_row)(uint8_t *dst, const uint8_t *src0, const uint8_t *src1, int width);
+
+void box_halve_plane(uint8_t *dst, int dst_linesize, const uint8_t *src, int src_linesize,
+    int src_width, int src_height);
+
+#define SAME_DIFF 20 // bytes differing by less are the same for blank detection
+
+/* # of i where pa[i], pb[i] & pc[i] are all the same */
+extern int (*count_same_bytes)(const uint8_t *pa, const uint8_t *pb, const uint8_t *pc, int n);
+
+int count_edges(const uint8_t *up, const uint8_t *row, const uint8_t *down, int width, int xbegin, int xend,
+    int threshold);
+
+#define ROTATE_BLOCK 32 // pixels; a block of source & destination rows stays in L1
+
+int rotate_pixels(int *const *dst, int dst_x, const int *const *src, int width, int height, int angle);
+
+/* clear the alpha bits of width x height gd truecolor pixels from column x of the rows */
+void opaque_pixels(int *const *rows, int x, int width, int height);
+
+void pixel_ops_init(void);
+const char *pixel_ops_name(void);
+
+#endif /* PIXEL_OPS_H_ */
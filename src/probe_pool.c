@@ -0,0 +1,255 @@
+#include "probe_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+// files are opened when they are processed on windows
+struct probe_pool *probe_pool_create(int nb_threads, probe_func probe, void *opaque)
+{
+    (void) nb_threads; (void) probe; (void) opaque;
+    return NULL;
+}
+
+void probe_pool_submit(struct probe_pool *pool, const char *url)
+{
+    (void) pool; (void) url;
+}
+
+int probe_pool_take(struct probe_pool *pool, const char *url, AVFormatContext **ctx, struct local_input *li,
+    int *ret, int *info_ret)
+{
+    (void) pool; (void) url; (void) ctx; (void) li; (void) ret; (void) info_ret;
+    return 0;
+}
+
+void probe_pool_discard(struct probe_pool *pool, const char *url)
+{
+    (void) pool; (void) url;
+}
+
+int probe_pool_nb_threads(const struct probe_pool *pool)
+{
+    (void) pool;
+    return 0;
+}
+
+void probe_pool_free(struct probe_pool *pool)
+{
+    (void) pool;
+}
+#else
+#include <pthread.h>
+
+enum probe_state { PROBE_QUEUED, PROBE_RUNNING, PROBE_DONE };
+
+struct probed_input
+{
+    char *url;
+    enum probe_state state;
+    AVFormatContext *ctx;
+    struct local_input li;
+    int ret;      // of avformat_open_input()
+    int info_ret; // of avformat_find_stream_info()
+};
+
+struct probe_pool
+{
+    probe_func probe;
+    void *opaque;
+    int nb_threads;
+    pthread_t threads[PROBE_POOL_MAX];
+    pthread_mutex_t lock;
+    pthread_cond_t cond; // a file is queued or done
+    int quit;
+    int nb_items;
+    struct probed_input *items[PROBE_POOL_MAX]; // in order of submission
+};
+
+static void close_item(struct probed_input *pi)
+{
+    if (pi->ctx)
+        avformat_close_input(&pi->ctx);
+    local_input_close(&pi->li);
+    free(pi->url);
+    free(pi);
+}
+
+static void *worker(void *arg)
+{
+    struct probe_pool *pool = arg;
+    pthread_mutex_lock(&pool->lock);
+    for (;;)
+    {
+        struct probed_input *pi = NULL;
+        int i;
+        for (i = 0; i < pool->nb_items && !pi; i++)
+            if (pool->items[i]->state == PROBE_QUEUED)
+                pi = pool->items[i];
+        if (pool->quit)
+            break;
+        if (!pi)
+        {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+            continue;
+        }
+        pi->state = PROBE_RUNNING;
+        pthread_mutex_unlock(&pool->lock);
+
+        pi->ret = pool->probe(pool->opaque, pi->url, &pi->ctx, &pi->li, &pi->info_ret);
+
+        pthread_mutex_lock(&pool->lock);
+        pi->state = PROBE_DONE;
+        pthread_cond_broadcast(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/*
+return NULL if no thread could be started
+*/
+struct probe_pool *probe_pool_create(int nb_threads, probe_func probe, void *opaque)
+{
+    if (nb_threads <= 0)
+        return NULL;
+    struct probe_pool *pool = calloc(1, sizeof(*pool));
+    if (!pool)
+        return NULL;
+    pool->probe = probe;
+    pool->opaque = opaque;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    if (nb_threads > PROBE_POOL_MAX)
+        nb_threads = PROBE_POOL_MAX;
+    while (pool->nb_threads < nb_threads
+        && !pthread_create(&pool->threads[pool->nb_threads], NULL, worker, pool))
+        pool->nb_threads++;
+    if (!pool->nb_threads)
+    {
+        probe_pool_free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+/*
+queue url to be opened & probed; ignored if the queue is full
+*/
+void probe_pool_submit(struct probe_pool *pool, const char *url)
+{
+    if (!pool)
+        return;
+    struct probed_input *pi = calloc(1, sizeof(*pi));
+    if (!pi || !(pi->url = strdup(url)))
+    {
+        free(pi);
+        return;
+    }
+    pi->state = PROBE_QUEUED;
+    local_input_init(&pi->li);
+    pthread_mutex_lock(&pool->lock);
+    if (pool->nb_items < PROBE_POOL_MAX)
+    {
+        pool->items[pool->nb_items++] = pi;
+        pi = NULL;
+        pthread_cond_broadcast(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (pi)
+        close_item(pi);
+}
+
+/*
+remove url from the pool, waiting for its probe if it's running.
+return NULL if it's not in the pool or wasn't started yet
+*/
+static struct probed_input *remove_item(struct probe_pool *pool, const char *url)
+{
+    struct probed_input *pi = NULL;
+    int i;
+    pthread_mutex_lock(&pool->lock);
+    for (i = 0; i < pool->nb_items; i++)
+        if (!strcmp(pool->items[i]->url, url))
+        {
+            pi = pool->items[i];
+            break;
+        }
+    if (pi)
+    {
+        while (pi->state == PROBE_RUNNING)
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        // the item might have moved while waiting
+        for (i = 0; pool->items[i] != pi; i++)
+            ;
+        memmove(pool->items + i, pool->items + i + 1, (pool->nb_items - i - 1) * sizeof(*pool->items));
+        pool->nb_items--;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (pi && pi->state == PROBE_QUEUED)
+    {
+        close_item(pi);
+        pi = NULL;
+    }
+    return pi;
+}
+
+/*
+hand the probed url over: *ctx reads through li.
+return 1 if it's handed over, 0 if the caller has to open it
+*/
+int probe_pool_take(struct probe_pool *pool, const char *url, AVFormatContext **ctx, struct local_input *li,
+    int *ret, int *info_ret)
+{
+    if (!pool)
+        return 0;
+    struct probed_input *pi = remove_item(pool, url);
+    if (!pi)
+        return 0;
+    *ctx = pi->ctx;
+    pi->ctx = NULL;
+    local_input_move(li, &pi->li);
+    *ret = pi->ret;
+    *info_ret = pi->info_ret;
+    close_item(pi);
+    return 1;
+}
+
+/*
+close url if it's still in the pool, e.g. when its file was skipped
+*/
+void probe_pool_discard(struct probe_pool *pool, const char *url)
+{
+    if (!pool)
+        return;
+    struct probed_input *pi = remove_item(pool, url);
+    if (pi)
+        close_item(pi);
+}
+
+/*
+# of probing threads; 0 if there is no pool
+*/
+int probe_pool_nb_threads(const struct probe_pool *pool)
+{
+    return pool ? pool->nb_threads : 0;
+}
+
+void probe_pool_free(struct probe_pool *pool)
+{
+    if (!pool)
+        return;
+    int i;
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    // running probes are finished first
+    for (i = 0; i < pool->nb_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+    for (i = 0; i < pool->nb_items; i++)
+        close_item(pool->items[i]);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond);
+    free(pool);
+}
+#endif
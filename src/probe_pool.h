@@ -0,0 +1,34 @@
+#ifndef PROBE_POOL_H_
+#define PROBE_POOL_H_
+
+#include "local_input.h"
+#include <libavformat/avformat.h>
+
+/*
+small pool of i/o threads which open & probe the next files of a batch
+(avformat_open_input() & avformat_find_stream_info(), e.g. moov atoms at
+the end of mp4 files) while the current file is decoded. the opened
+context is handed over when its file is processed; files which aren't
+probed yet are opened by the caller as before.
+*/
+
+#define PROBE_POOL_FILES 2 // default # of files probed ahead
+#define PROBE_POOL_MAX 16
+
+/*
+open url into *ctx, reading it through li; *info_ret is avformat_find_stream_info()'s result.
+return value is the same as avformat_open_input()'s
+*/
+typedef int (*probe_func)(void *opaque, const char *url, AVFormatContext **ctx, struct local_input *li, int *info_ret);
+
+struct probe_pool;
+
+struct probe_pool *probe_pool_create(int nb_threads, probe_func probe, void *opaque);
+void probe_pool_submit(struct probe_pool *pool, const char *url);
+int probe_pool_take(struct probe_pool *pool, const char *url, AVFormatContext **ctx, struct local_input *li,
+    int *ret, int *info_ret);
+void probe_pool_discard(struct probe_pool *pool, const char *url);
+int probe_pool_nb_threads(const struct probe_pool *pool);
+void probe_pool_free(struct probe_pool *pool);
+
+#endif /* PROBE_POOL_H_ */
@@ -0,0 +1,115 @@
+#include "pyramid.h"
+#include "pixel_ops.h"
+#include <libavutil/pixdesc.h>
+
+void pyramid_init(struct pyramid *p)
+{
+    int i;
+    p->nb_levels = 0;
+    p->width = p->src_width = 0;
+    p->height = p->src_height = 0;
+    p->nb_planes = 0;
+    p->log2_chroma_w = p->log2_chroma_h = 0;
+    for (i = 0; i < PYRAMID_MAX; i++)
+        p->levels[i] = NULL;
+}
+
+void pyramid_free(struct pyramid *p)
+{
+    int i;
+    for (i = 0; i < PYRAMID_MAX; i++)
+        av_frame_free(&p->levels[i]);
+    pyramid_init(p);
+}
+
+/*
+return # of planes if pix_fmt has 8-bit samples each in a plane of its own, 0 if not
+*/
+static int planar_8bit(enum AVPixelFormat pix_fmt)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+    int i, nb_planes = 0;
+    if (!desc || desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM))
+        return 0;
+    for (i = 0; i < desc->nb_components; i++)
+    {
+        // step 1 = no other component between the samples (not nv12 etc.)
+        if (desc->comp[i].depth != 8 || desc->comp[i].step != 1 || desc->comp[i].shift)
+            return 0;
+        if (desc->comp[i].plane >= nb_planes)
+            nb_planes = desc->comp[i].plane + 1;
+    }
+    return nb_planes;
+}
+
+/*
+prepare the levels between src_width x src_height pix_fmt frames and
+dst_width x dst_height shots; none if the source isn't big enough or its
+format isn't supported.
+return 0 if ok, -1 if out of memory
+*/
+int pyramid_open(struct pyramid *p, int src_width, int src_height, enum AVPixelFormat pix_fmt,
+    int dst_width, int dst_height)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+    int w = src_width, h = src_height;
+    pyramid_free(p);
+    p->src_width = p->width = src_width;
+    p->src_height = p->height = src_height;
+    p->nb_planes = planar_8bit(pix_fmt);
+    if (!p->nb_planes)
+        return 0;
+    if (!(desc->flags & AV_PIX_FMT_FLAG_RGB))
+    {
+        p->log2_chroma_w = desc->log2_chroma_w;
+        p->log2_chroma_h = desc->log2_chroma_h;
+    }
+    // the last level is still at least twice the shot
+    while (p->nb_levels < PYRAMID_MAX && dst_width > 0 && dst_height > 0
+        && w >= 4 * dst_width && h >= 4 * dst_height)
+    {
+        AVFrame *frame = av_frame_alloc();
+        if (!frame)
+            return -1;
+        p->levels[p->nb_levels++] = frame;
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+        frame->width = w;
+        frame->height = h;
+        frame->format = pix_fmt;
+        if (av_frame_get_buffer(frame, 32) < 0)
+            return -1;
+    }
+    p->width = w;
+    p->height = h;
+    return 0;
+}
+
+static int plane_size(int size, int log2)
+{
+    return (size + (1 << log2) - 1) >> log2;
+}
+
+/*
+return src reduced by all levels, or src itself if there are none.
+src must be a frame of the size & format given to pyramid_open()
+*/
+const AVFrame *pyramid_reduce(struct pyramid *p, const AVFrame *src)
+{
+    int i, j, w = p->src_width, h = p->src_height;
+    for (i = 0; i < p->nb_levels; i++)
+    {
+        AVFrame *dst = p->levels[i];
+        for (j = 0; j < p->nb_planes; j++)
+        {
+            int chroma = j == 1 || j == 2;
+            // (size + 1) / 2 of the level is the same as halving the subsampled plane
+            box_halve_plane(dst->data[j], dst->linesize[j], src->data[j], src->linesize[j],
+                chroma ? plane_size(w, p->log2_chroma_w) : w, chroma ? plane_size(h, p->log2_chroma_h) : h);
+        }
+        src = dst;
+        w = dst->width;
+        h = dst->height;
+    }
+    return src;
+}
@@ -0,0 +1,33 @@
+#ifndef PYRAMID_H_
+#define PYRAMID_H_
+
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+
+/*
+2x box reductions of big (4K, 8K) decoded frames before swscale. planes of
+8-bit planar formats (yuv420p & friends) are halved until the frame is
+less than 4 times the size of the shot, so swscale only does the last
+step (2:1 to 4:1) on a small frame; that's faster and doesn't alias like
+a single bilinear pass from 7680 px to 240 px.
+*/
+
+#define PYRAMID_MAX 8 // levels; 256:1
+
+struct pyramid
+{
+    int nb_levels; // 0 = frames are scaled as they are
+    int width, height; // of the reduced frames
+    int src_width, src_height;
+    int nb_planes;
+    int log2_chroma_w, log2_chroma_h; // of planes 1 & 2; 0 for rgb
+    AVFrame *levels[PYRAMID_MAX];
+};
+
+void pyramid_init(struct pyramid *p);
+int pyramid_open(struct pyramid *p, int src_width, int src_height, enum AVPixelFormat pix_fmt,
+    int dst_width, int dst_height);
+const AVFrame *pyramid_reduce(struct pyramid *p, const AVFrame *src);
+void pyramid_free(struct pyramid *p);
+
+#endif /* PYRAMID_H_ */
@@ -0,0 +1,160 @@
+#include "render_cache.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct text_cache_entry
+{
+    char *font; // NULL = free
+    double size;
+    int padding; // -1 = not measured yet
+    struct glyph_atlas glyphs;
+    int64_t last_used;
+};
+
+struct shadow_cache_entry
+{
+    gdImagePtr shadow; // NULL = free
+    struct shadow_key key;
+    int radius;
+    int64_t last_used;
+};
+
+static struct text_cache_entry gb_text_cache[TEXT_CACHE_SIZE];
+static struct shadow_cache_entry gb_shadow_cache[SHADOW_CACHE_SIZE];
+static int64_t gb_render_cache_clock = 0;
+
+static void free_text_entry(struct text_cache_entry *e)
+{
+    free(e->font);
+    e->font = NULL;
+    glyph_atlas_free(&e->glyphs);
+}
+
+/*
+return the entry of font & size; the least recently used one is reused if
+the cache is full. NULL if out of memory
+*/
+static struct text_cache_entry *text_entry(const char *font, double size)
+{
+    struct text_cache_entry *victim = &gb_text_cache[0];
+    int i;
+    for (i = 0; i < TEXT_CACHE_SIZE; i++)
+    {
+        struct text_cache_entry *e = &gb_text_cache[i];
+        if (e->font && e->size == size && !strcmp(e->font, font))
+        {
+            e->last_used = ++gb_render_cache_clock;
+            return e;
+        }
+        if (!victim->font)
+            continue;
+        if (!e->font || e->last_used < victim->last_used)
+            victim = e;
+    }
+    free_text_entry(victim);
+    if (!(victim->font = strdup(font)))
+        return NULL;
+    victim->size = size;
+    victim->padding = -1;
+    victim->last_used = ++gb_render_cache_clock;
+    return victim;
+}
+
+/*
+return 1 if *padding of font & size is known, 0 if it has to be measured
+*/
+int render_cache_get_padding(const char *font, double size, int *padding)
+{
+    const struct text_cache_entry *e = text_entry(font, size);
+    if (!e || e->padding < 0)
+        return 0;
+    *padding = e->padding;
+    return 1;
+}
+
+void render_cache_put_padding(const char *font, double size, int padding)
+{
+    struct text_cache_entry *e = text_entry(font, size);
+    if (e)
+        e->padding = padding;
+}
+
+/*
+return timestamp glyphs of font & size, rasterized on the first call.
+they're owned by the cache & stay valid until TEXT_CACHE_SIZE other fonts
+or sizes are used. NULL & *err set if they couldn't be rasterized
+*/
+const struct glyph_atlas *render_cache_glyphs(const char *font, double size, char **err)
+{
+    struct text_cache_entry *e = text_entry(font, size);
+    if (!e)
+    {
+        *err = "out of memory";
+        return NULL;
+    }
+    if (!e->glyphs.coverage && (*err = glyph_atlas_open(&e->glyphs, font, size)))
+        return NULL;
+    return &e->glyphs;
+}
+
+/*
+return a blurred shadow for key k & set *radius to its radius, NULL if
+there is none. the caller owns it until render_cache_put_shadow()
+*/
+gdImagePtr render_cache_get_shadow(const struct shadow_key *k, int *radius)
+{
+    int i;
+    for (i = 0; i < SHADOW_CACHE_SIZE; i++)
+    {
+        struct shadow_cache_entry *e = &gb_shadow_cache[i];
+        if (e->shadow && !memcmp(&e->key, k, sizeof(*k)))
+        {
+            gdImagePtr shadow = e->shadow;
+            e->shadow = NULL;
+            *radius = e->radius;
+            return shadow;
+        }
+    }
+    return NULL;
+}
+
+/*
+keep shadow for the next file; the least recently used one is destroyed
+if the cache is full
+*/
+void render_cache_put_shadow(gdImagePtr shadow, const struct shadow_key *k, int radius)
+{
+    struct shadow_cache_entry *victim = &gb_shadow_cache[0];
+    int i;
+    for (i = 0; i < SHADOW_CACHE_SIZE; i++)
+    {
+        struct shadow_cache_entry *e = &gb_shadow_cache[i];
+        if (!e->shadow)
+        {
+            victim = e;
+            break;
+        }
+        if (e->last_used < victim->last_used)
+            victim = e;
+    }
+    if (victim->shadow)
+        gdImageDestroy(victim->shadow);
+    victim->shadow = shadow;
+    victim->key = *k;
+    victim->radius = radius;
+    victim->last_used = ++gb_render_cache_clock;
+}
+
+void render_cache_free()
+{
+    int i;
+    for (i = 0; i < TEXT_CACHE_SIZE; i++)
+        free_text_entry(&gb_text_cache[i]);
+    for (i = 0; i < SHADOW_CACHE_SIZE; i++)
+        if (gb_shadow_cache[i].shadow)
+        {
+            gdImageDestroy(gb_shadow_cache[i].shadow);
+            gb_shadow_cache[i].shadow = NULL;
+        }
+}
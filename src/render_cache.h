@@ -0,0 +1,30 @@
+#ifndef RENDER_CACHE_H_
+#define RENDER_CACHE_H_
+
+#include "glyph_atlas.h"
+#include <gd.h>
+
+/*
+text metrics, timestamp glyphs & blurred shadows kept across files of a
+batch, so fonts are measured & rasterized and shadows are blurred again
+only when the font, size, tile size or colors change.
+*/
+
+#define TEXT_CACHE_SIZE 4 // fonts & sizes; info text & timestamps
+#define SHADOW_CACHE_SIZE 4
+
+struct shadow_key
+{
+    int background;
+    int width, height; // of the shot
+    int radius; // as requested; 0 = from the shot size
+};
+
+int render_cache_get_padding(const char *font, double size, int *padding);
+void render_cache_put_padding(const char *font, double size, int padding);
+const struct glyph_atlas *render_cache_glyphs(const char *font, double size, char **err);
+gdImagePtr render_cache_get_shadow(const struct shadow_key *k, int *radius);
+void render_cache_put_shadow(gdImagePtr shadow, const struct shadow_key *k, int radius);
+void render_cache_free();
+
+#endif /* RENDER_CACHE_H_ */
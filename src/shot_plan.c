@@ -0,0 +1,162 @@
+#include "shot_plan.h"
+#include <stdlib.h>
+#include <libavformat/avformat.h>
+
+void shot_plan_init(struct shot_plan *sp)
+{
+    sp->nb_targets = 0;
+    sp->targets = NULL;
+    sp->keyframes = NULL;
+    sp->nb_seeks = 0;
+    sp->approx = NULL;
+}
+
+/*
+return -1 if failed
+*/
+int shot_plan_alloc(struct shot_plan *sp, int nb_targets)
+{
+    shot_plan_free(sp);
+    if (nb_targets <= 0)
+        return -1;
+    sp->targets = malloc(nb_targets * sizeof(*sp->targets));
+    sp->keyframes = malloc(nb_targets * sizeof(*sp->keyframes));
+    sp->approx = calloc(nb_targets, sizeof(*sp->approx));
+    if (!sp->targets || !sp->keyframes || !sp->approx)
+    {
+        shot_plan_free(sp);
+        return -1;
+    }
+    sp->nb_targets = nb_targets;
+    return 0;
+}
+
+void shot_plan_fill_steps(struct shot_plan *sp, int64_t first, int64_t step)
+{
+    int i;
+    for (i = 0; i < sp->nb_targets; i++)
+        sp->targets[i] = first + i * step;
+}
+
+/*
+return pts of the last key frame at or before timestamp,
+AV_NOPTS_VALUE if the stream's index doesn't cover it
+*/
+int64_t shot_plan_keyframe(struct AVStream *st, int64_t timestamp)
+{
+    // without AVSEEK_FLAG_ANY only key frames are returned
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+    const AVIndexEntry *e = avformat_index_get_entry_from_timestamp(st, timestamp, AVSEEK_FLAG_BACKWARD);
+#else
+    int i = av_index_search_timestamp(st, timestamp, AVSEEK_FLAG_BACKWARD);
+    const AVIndexEntry *e = i >= 0 ? &st->index_entries[i] : NULL;
+#endif
+    if (!e)
+        return AV_NOPTS_VALUE;
+    return e->timestamp;
+}
+
+/*
+return pts of the first key frame after timestamp,
+AV_NOPTS_VALUE if the stream's index doesn't cover it
+*/
+int64_t shot_plan_next_keyframe(struct AVStream *st, int64_t timestamp)
+{
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+    const AVIndexEntry *e = avformat_index_get_entry_from_timestamp(st, timestamp + 1, 0);
+#else
+    int i = av_index_search_timestamp(st, timestamp + 1, 0);
+    const AVIndexEntry *e = i >= 0 ? &st->index_entries[i] : NULL;
+#endif
+    if (!e)
+        return AV_NOPTS_VALUE;
+    return e->timestamp;
+}
+
+/*
+return 1 if the decoder, which is at decoder_pts, can get to target by
+decoding forward without crossing a key frame
+*/
+int shot_plan_in_gop(struct AVStream *st, int64_t decoder_pts, int64_t target)
+{
+    if (decoder_pts == AV_NOPTS_VALUE || decoder_pts < 0 || decoder_pts >= target)
+        return 0;
+    int64_t key = shot_plan_keyframe(st, target);
+    return key != AV_NOPTS_VALUE && key <= decoder_pts;
+}
+
+/*
+get the byte range of the file which has to be read to decode target:
+from its key frame to the next key frame. *size is -1 if the end isn't
+indexed. return -1 if the key frame isn't indexed
+*/
+int shot_plan_byte_range(struct AVStream *st, int64_t target, int64_t *pos, int64_t *size)
+{
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+    const AVIndexEntry *key = avformat_index_get_entry_from_timestamp(st, target, AVSEEK_FLAG_BACKWARD);
+    const AVIndexEntry *next = avformat_index_get_entry_from_timestamp(st, target + 1, 0);
+#else
+    int i = av_index_search_timestamp(st, target, AVSEEK_FLAG_BACKWARD);
+    int j = av_index_search_timestamp(st, target + 1, 0);
+    const AVIndexEntry *key = i >= 0 ? &st->index_entries[i] : NULL;
+    const AVIndexEntry *next = j >= 0 ? &st->index_entries[j] : NULL;
+#endif
+    if (!key || key->pos < 0)
+        return -1;
+    *pos = key->pos;
+    *size = next && next->pos > key->pos ? next->pos - key->pos : -1;
+    return 0;
+}
+
+static int needs_seek(const struct shot_plan *sp, int i)
+{
+    return i == 0 || sp->keyframes[i] == AV_NOPTS_VALUE || sp->keyframes[i] > sp->targets[i-1];
+}
+
+void shot_plan_map_keyframes(struct shot_plan *sp, struct AVStream *st)
+{
+    int i;
+    sp->nb_seeks = 0;
+    for (i = 0; i < sp->nb_targets; i++)
+    {
+        sp->keyframes[i] = shot_plan_keyframe(st, sp->targets[i]);
+        if (needs_seek(sp, i))
+            sp->nb_seeks++;
+    }
+}
+
+/*
+keep at most max_seeks of the seeks, spread evenly over the targets; the
+other targets which need a seek are marked approximated.
+return # of approximated targets
+*/
+int shot_plan_limit_seeks(struct shot_plan *sp, int max_seeks)
+{
+    int i, k = 0, nb_approx = 0;
+    if (max_seeks <= 0 || sp->nb_seeks <= max_seeks)
+        return 0;
+    for (i = 0; i < sp->nb_targets; i++)
+    {
+        if (!needs_seek(sp, i))
+            continue;
+        // seek #k is kept when the even spread of max_seeks steps over it
+        int64_t prev = (int64_t) (k - 1) * max_seeks / sp->nb_seeks;
+        int64_t curr = (int64_t) k * max_seeks / sp->nb_seeks;
+        if (k > 0 && curr == prev)
+        {
+            sp->approx[i] = 1;
+            nb_approx++;
+        }
+        k++;
+    }
+    sp->nb_seeks -= nb_approx;
+    return nb_approx;
+}
+
+void shot_plan_free(struct shot_plan *sp)
+{
+    free(sp->targets);
+    free(sp->keyframes);
+    free(sp->approx);
+    shot_plan_init(sp);
+}
@@ -0,0 +1,33 @@
+#ifndef SHOT_PLAN_H_
+#define SHOT_PLAN_H_
+
+#include <stdint.h>
+
+struct AVStream;
+
+/*
+list of seek targets for one thumbnail, each mapped to the key frame
+which governs it. targets sharing a key frame (GOP) can be reached by
+decoding forward instead of seeking & flushing the decoder.
+*/
+struct shot_plan
+{
+    int nb_targets;
+    int64_t *targets;   // in stream time_base units, ascending
+    int64_t *keyframes; // pts of governing key frame; AV_NOPTS_VALUE if not indexed
+    int nb_seeks;       // # of targets which can't be reached from the previous one
+    char *approx;       // 1 = over the seek budget; taken from the next key frame without seeking
+};
+
+void shot_plan_init(struct shot_plan *sp);
+int shot_plan_alloc(struct shot_plan *sp, int nb_targets);
+void shot_plan_fill_steps(struct shot_plan *sp, int64_t first, int64_t step);
+void shot_plan_map_keyframes(struct shot_plan *sp, struct AVStream *st);
+int64_t shot_plan_keyframe(struct AVStream *st, int64_t timestamp);
+int64_t shot_plan_next_keyframe(struct AVStream *st, int64_t timestamp);
+int shot_plan_limit_seeks(struct shot_plan *sp, int max_seeks);
+int shot_plan_in_gop(struct AVStream *st, int64_t decoder_pts, int64_t target);
+int shot_plan_byte_range(struct AVStream *st, int64_t target, int64_t *pos, int64_t *size);
+void shot_plan_free(struct shot_plan *sp);
+
+#endif /* SHOT_PLAN_H_ */
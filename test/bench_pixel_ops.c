@@ -0,0 +1,324 @@
+/*
+microbenchmark of the kernels in src/pixel_ops.c on 1080p shots, 4K planes & tiles;
+build with "make bench" in src & run ../bin/bench_pixel_ops [iterations]
+*/
+#include "pixel_ops.h"
+#include "measure_time.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gd.h>
+#include <libavutil/cpu.h>
+
+#define WIDTH 1920
+#define HEIGHT 1080
+
+static uint8_t *gb_rgb; // WIDTH x HEIGHT rgb24
+static gdImagePtr gb_portrait; // HEIGHT x WIDTH, e.g. a phone video
+static int gb_angle;
+static uint8_t *gb_plane; // 2 * WIDTH + 1 x 2 * HEIGHT + 1 luma of a 4K movie, odd to cover the edges
+static uint8_t *gb_halved;
+static int gb_tile_width, gb_tile_height; // of the blank detection
+static int gb_same; // bytes found the same in the last run
+static int gb_edge_d; // -D of edge detection
+
+// what FrameRGB_2_gdImage() used to do
+static void convert_gd(gdImagePtr ip)
+{
+    const uint8_t *src = gb_rgb;
+    int x, y;
+    for (y = 0; y < HEIGHT; y++)
+        for (x = 0; x < WIDTH; x++, src += 3)
+            gdImageSetPixel(ip, x, y, gdImageColorResolve(ip, src[0], src[1], src[2]));
+}
+
+static void convert_rows(gdImagePtr ip)
+{
+    int y;
+    for (y = 0; y < HEIGHT; y++)
+        rgb24_to_truecolor_row(ip->tpixels[y], gb_rgb + y * WIDTH * 3, WIDTH);
+}
+
+// what rotate_gdImage() used to do (without its off-by-one)
+static void rotate_gd(gdImagePtr ip)
+{
+    int i, j;
+    for (i = 0; i < HEIGHT; i++)
+        for (j = 0; j < WIDTH; j++)
+            switch (gb_angle)
+            {
+            case 90:
+                gdImageSetPixel(ip, j, HEIGHT - 1 - i, gdImageGetPixel(gb_portrait, i, j));
+                break;
+            case -90:
+                gdImageSetPixel(ip, WIDTH - 1 - j, i, gdImageGetPixel(gb_portrait, i, j));
+                break;
+            }
+}
+
+static void rotate_blocks(gdImagePtr ip)
+{
+    rotate_pixels(ip->tpixels, 0, (const int * const *) gb_portrait->tpixels, HEIGHT, WIDTH, gb_angle);
+}
+
+static int same_pixels(gdImagePtr a, gdImagePtr b)
+{
+    int y;
+    for (y = 0; y < HEIGHT; y++)
+        if (memcmp(a->tpixels[y], b->tpixels[y], WIDTH * sizeof(int)))
+            return 0;
+    return 1;
+}
+
+static void halve_plane(gdImagePtr ip)
+{
+    (void) ip;
+    box_halve_plane(gb_halved, WIDTH + 1, gb_plane, 2 * WIDTH + 1, 2 * WIDTH + 1, 2 * HEIGHT + 1);
+}
+
+// what uint8_cmp() used to do
+static int count_same_abs(const uint8_t *pa, const uint8_t *pb, const uint8_t *pc, int n)
+{
+    int i, same = 0;
+    for (i = 0; i < n; i++)
+    {
+        int diffab = pa[i] - pb[i];
+        int diffac = pa[i] - pc[i];
+        int diffbc = pb[i] - pc[i];
+        if (abs(diffab) < 20 && abs(diffac) < 20 && abs(diffbc) < 20)
+            same++;
+    }
+    return same;
+}
+
+// the bands of blank_plane() on an rgb24 tile of gb_rgb
+static void blank_bands(int (*count)(const uint8_t *, const uint8_t *, const uint8_t *, int))
+{
+    int hor_size = gb_tile_height / 11 * gb_tile_width * 3;
+    int ver_size = hor_size / 3;
+    const uint8_t *pa = gb_rgb + hor_size * 2;
+    const uint8_t *pb = gb_rgb + hor_size * 5;
+    const uint8_t *pc = gb_rgb + hor_size * 8;
+    gb_same = count(pa, pb, pc, hor_size)
+        + count(pa, pa + ver_size, pa + ver_size * 2, ver_size)
+        + count(pb, pb + ver_size, pb + ver_size * 2, ver_size)
+        + count(pc, pc + ver_size, pc + ver_size * 2, ver_size);
+}
+
+static void blank_abs(gdImagePtr ip)
+{
+    (void) ip;
+    blank_bands(count_same_abs);
+}
+
+static void blank_kernel(gdImagePtr ip)
+{
+    (void) ip;
+    blank_bands(count_same_bytes);
+}
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
+#define MAX(a,b) ((a)>(b)?(a):(b))
+
+// what detect_edge() does per pixel, on a gray8 tile of gb_rgb
+static void edge_float(gdImagePtr ip)
+{
+    float center = gb_edge_d;
+    float side = -gb_edge_d/4.0f;
+    int x, y;
+    (void) ip;
+    gb_same = 0;
+    for (y = 0; y < gb_tile_height; y++)
+    {
+        const uint8_t *up = gb_rgb + MAX(y - 1, 0) * gb_tile_width;
+        const uint8_t *row = gb_rgb + y * gb_tile_width;
+        const uint8_t *down = gb_rgb + MIN(y + 1, gb_tile_height - 1) * gb_tile_width;
+        for (x = 0; x < gb_tile_width; x++)
+        {
+            float v = center * row[x] + side * (up[x] + down[x] + row[MAX(x - 1, 0)] + row[MIN(x + 1, gb_tile_width - 1)]) + 128;
+            v = v > 255.0f ? 255.0f : v < 0.0f ? 0.0f : v;
+            gb_same += (int) v >= 180;
+        }
+    }
+}
+
+static void edge_kernel(gdImagePtr ip)
+{
+    int threshold = (4 * (180 - 128) + gb_edge_d - 1) / gb_edge_d;
+    int y;
+    (void) ip;
+    gb_same = 0;
+    for (y = 0; y < gb_tile_height; y++)
+        gb_same += count_edges(gb_rgb + MAX(y - 1, 0) * gb_tile_width, gb_rgb + y * gb_tile_width,
+            gb_rgb + MIN(y + 1, gb_tile_height - 1) * gb_tile_width, gb_tile_width, 0, gb_tile_width - 1, threshold);
+}
+
+static double run(void (*convert)(gdImagePtr), gdImagePtr ip, int iterations)
+{
+    int i;
+    convert(ip); // warm up
+    int64_t start = get_current_time();
+    for (i = 0; i < iterations; i++)
+        convert(ip);
+    return diff_time_sec(start, get_current_time()) * 1000 / iterations;
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 50;
+    int i;
+    if (iterations <= 0)
+        iterations = 50;
+    gb_rgb = malloc(WIDTH * HEIGHT * 3);
+    gdImagePtr ref = gdImageCreateTrueColor(WIDTH, HEIGHT);
+    gdImagePtr ip = gdImageCreateTrueColor(WIDTH, HEIGHT);
+    if (!gb_rgb || !ref || !ip)
+        return 1;
+    srand(1);
+    for (i = 0; i < WIDTH * HEIGHT * 3; i++)
+        gb_rgb[i] = rand();
+
+    double base = run(convert_gd, ref, iterations);
+    printf("rgb24 -> gd %dx%d, ms per shot\n", WIDTH, HEIGHT);
+    printf("  %-22s %8.3f\n", "gdImageSetPixel", base);
+
+    // kernels from plain c up to the best one of this cpu
+    static const int levels[] = { 0, AV_CPU_FLAG_SSE2, AV_CPU_FLAG_SSSE3, AV_CPU_FLAG_AVX2, AV_CPU_FLAG_NEON };
+    int cpu_flags = av_get_cpu_flags();
+    // a level is skipped if it doesn't change the kernel
+    void (*prev_rgb)(int *, const uint8_t *, int) = NULL;
+    void (*prev_box)(uint8_t *, const uint8_t *, const uint8_t *, int) = NULL;
+    int (*prev_same)(const uint8_t *, const uint8_t *, const uint8_t *, int) = NULL;
+    for (i = 0; i < (int) (sizeof(levels) / sizeof(*levels)); i++)
+    {
+        if (levels[i] && !(cpu_flags & levels[i]))
+            continue;
+        // flags are in order of instruction sets; keep the ones up to this level
+        av_force_cpu_flags(levels[i] ? cpu_flags & (levels[i] | (levels[i] - 1)) : 0);
+        pixel_ops_init();
+        if (rgb24_to_truecolor_row == prev_rgb)
+            continue;
+        prev_rgb = rgb24_to_truecolor_row;
+        double t = run(convert_rows, ip, iterations);
+        printf("  %-22s %8.3f  %5.1fx %s\n", pixel_ops_name(), t, base / t, same_pixels(ip, ref) ? "" : "MISMATCH");
+    }
+
+    // 2x2 box of a plane, compared with the c kernel
+    gb_plane = malloc((2 * WIDTH + 1) * (2 * HEIGHT + 1));
+    gb_halved = malloc((WIDTH + 1) * (HEIGHT + 1));
+    uint8_t *halved_c = malloc((WIDTH + 1) * (HEIGHT + 1));
+    if (!gb_plane || !gb_halved || !halved_c)
+        return 1;
+    for (i = 0; i < (2 * WIDTH + 1) * (2 * HEIGHT + 1); i++)
+        gb_plane[i] = rand();
+    printf("box 2x2 %dx%d plane, ms per plane\n", 2 * WIDTH + 1, 2 * HEIGHT + 1);
+    for (i = 0; i < (int) (sizeof(levels) / sizeof(*levels)); i++)
+    {
+        if (levels[i] && !(cpu_flags & levels[i]))
+            continue;
+        av_force_cpu_flags(levels[i] ? cpu_flags & (levels[i] | (levels[i] - 1)) : 0);
+        pixel_ops_init();
+        if (box_halve_row == prev_box)
+            continue;
+        double t = run(halve_plane, NULL, iterations);
+        if (!prev_box)
+        {
+            base = t;
+            memcpy(halved_c, gb_halved, (WIDTH + 1) * (HEIGHT + 1));
+        }
+        prev_box = box_halve_row;
+        printf("  %-22s %8.3f  %5.1fx %s\n", pixel_ops_name(), t, base / t,
+            memcmp(gb_halved, halved_c, (WIDTH + 1) * (HEIGHT + 1)) ? "MISMATCH" : "");
+    }
+    free(halved_c);
+    free(gb_halved);
+    free(gb_plane);
+
+    // blank detection of typical tiles; dark noise so both outcomes are common
+    static const int tiles[][2] = { { 160, 90 }, { 256, 144 }, { 480, 270 }, { 1024, 576 } };
+    int t;
+    for (i = 0; i < WIDTH * HEIGHT * 3; i++)
+        gb_rgb[i] = 16 + rand() % 40;
+    printf("blank detection of rgb24 tiles, us per tile\n");
+    for (t = 0; t < (int) (sizeof(tiles) / sizeof(*tiles)); t++)
+    {
+        gb_tile_width = tiles[t][0];
+        gb_tile_height = tiles[t][1];
+        int reps = iterations * 100;
+        base = run(blank_abs, NULL, reps) * 1000;
+        int same_ref = gb_same;
+        printf("  %4dx%-4d abs()         %8.3f\n", gb_tile_width, gb_tile_height, base);
+        prev_same = NULL;
+        for (i = 0; i < (int) (sizeof(levels) / sizeof(*levels)); i++)
+        {
+            if (levels[i] && !(cpu_flags & levels[i]))
+                continue;
+            av_force_cpu_flags(levels[i] ? cpu_flags & (levels[i] | (levels[i] - 1)) : 0);
+            pixel_ops_init();
+            if (count_same_bytes == prev_same)
+                continue;
+            prev_same = count_same_bytes;
+            double k = run(blank_kernel, NULL, reps) * 1000;
+            printf("  %4dx%-4d %-13s %8.3f  %5.1fx %s\n", gb_tile_width, gb_tile_height, pixel_ops_name(), k, base / k,
+                gb_same == same_ref ? "" : "MISMATCH");
+        }
+    }
+
+    // laplacian of gray8 tiles
+    printf("edge detection of gray8 tiles, us per tile\n");
+    for (t = 0; t < (int) (sizeof(tiles) / sizeof(*tiles)); t++)
+    {
+        gb_tile_width = tiles[t][0];
+        gb_tile_height = tiles[t][1];
+        for (gb_edge_d = 4; gb_edge_d <= 12; gb_edge_d += 8)
+        {
+            int reps = iterations * 20;
+            av_force_cpu_flags(-1);
+            base = run(edge_float, NULL, reps) * 1000;
+            int same_ref = gb_same;
+            printf("  %4dx%-4d -D%-2d float   %8.3f\n", gb_tile_width, gb_tile_height, gb_edge_d, base);
+            prev_same = NULL;
+            for (i = 0; i < (int) (sizeof(levels) / sizeof(*levels)); i++)
+            {
+                if (levels[i] && !(cpu_flags & levels[i]))
+                    continue;
+                av_force_cpu_flags(levels[i] ? cpu_flags & (levels[i] | (levels[i] - 1)) : 0);
+                pixel_ops_init();
+                // count_edges() dispatches by the same flags as count_same_bytes()
+                if (count_same_bytes == prev_same)
+                    continue;
+                prev_same = count_same_bytes;
+                double k = run(edge_kernel, NULL, reps) * 1000;
+                printf("  %4dx%-4d -D%-2d %-7s %8.3f  %5.1fx %s\n", gb_tile_width, gb_tile_height, gb_edge_d,
+                    pixel_ops_name(), k, base / k, gb_same == same_ref ? "" : "MISMATCH");
+            }
+        }
+    }
+
+    for (i = 0; i < WIDTH * HEIGHT * 3; i++)
+        gb_rgb[i] = rand();
+    av_force_cpu_flags(-1);
+    pixel_ops_init();
+
+    // portrait shot turned into a landscape one
+    gb_portrait = gdImageCreateTrueColor(HEIGHT, WIDTH);
+    if (!gb_portrait)
+        return 1;
+    for (i = 0; i < WIDTH; i++)
+        rgb24_to_truecolor_row(gb_portrait->tpixels[i], gb_rgb + i * HEIGHT * 3, HEIGHT);
+    printf("rotate %dx%d, ms per shot\n", HEIGHT, WIDTH);
+    for (gb_angle = 90; gb_angle >= -90; gb_angle -= 180)
+    {
+        base = run(rotate_gd, ref, iterations);
+        double t = run(rotate_blocks, ip, iterations);
+        printf("  %4d gdImageSetPixel    %8.3f\n", gb_angle, base);
+        printf("  %4d blocks of %d       %8.3f  %5.1fx %s\n", gb_angle, ROTATE_BLOCK, t, base / t,
+            same_pixels(ip, ref) ? "" : "MISMATCH");
+    }
+    gdImageDestroy(gb_portrait);
+
+    gdImageDestroy(ref);
+    gdImageDestroy(ip);
+    free(gb_rgb);
+    return 0;
+}
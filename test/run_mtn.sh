@@ -86,6 +86,10 @@ colouredecho  "===> Timestamp off "
 tcdir timestamp_off_title_on
 run_mtn -t -T timestamp-off
 
+colouredecho  "===> Shots scaled straight into the sheet (no timestamp & evasion)"
+tcdir direct_tiles
+run_mtn -t -b 2 -c 4 -r 4 --shadow=3
+
 colouredecho  "===> Shadows "
 tcdir shadows
 run_mtn --shadow=5 -g 12 -o .png
@@ -115,6 +119,124 @@ colouredecho  "===> WebVTT"
 tcdir webvtt
 run_mtn -c 4 -w 1280 -Ii --vtt=path_to_image/ -o.jpg
 
+colouredecho  "===> Shots at explicit times"
+tcdir explicit_times
+run_mtn --at=0:30,5,1:00.5,5 -I t
+
+colouredecho  "===> Info text and album art only"
+tcdir metadata_only
+run_mtn --metadata-only -N .txt --cover
+
+colouredecho  "===> Sheet of every video stream"
+tcdir all_video_streams
+run_mtn --all-video-streams
+
+colouredecho  "===> Large read buffer and FFmpeg's file protocol"
+tcdir io_buffer
+run_mtn --io-buffer=4096 -c 3 -r 3
+run_mtn --io-buffer=0 -c 3 -r 3 -o _0.jpg
+
+colouredecho  "===> Memory mapped input"
+tcdir mmap
+run_mtn --mmap -c 3 -r 3
+run_mtn --mmap -Z -c 3 -r 3 -o _Z.jpg
+
+colouredecho  "===> I/O budget"
+tcdir io_budget
+run_mtn --max-seeks=3 -c 3 -r 3
+run_mtn --max-seeks=3 --max-read-bytes=20M -c 3 -r 3 -o _bytes.jpg
+
+colouredecho  "===> Files probed ahead and opened when processed"
+tcdir prefetch
+run_mtn --prefetch=4 -d 1 -c 3 -r 3
+run_mtn --prefetch=0 -d 1 -c 3 -r 3 -o _0.jpg
+
+colouredecho  "===> Resize filters after halving big frames"
+tcdir scaler
+run_mtn --scaler=lanczos -c 8 -r 3 -w 800
+run_mtn --scaler=area -t -b 2 -c 8 -r 3 -w 800 -o _area.jpg
+
+colouredecho  "===> Timestamps & shadows drawn straight into the tiles"
+tcdir direct_tiles
+run_mtn -c 4 -r 3 -L 4:2
+run_mtn -c 4 -r 3 -D 8 -B 1 -E 1 -o _shadow.jpg --shadow=3
+
+colouredecho  "===> Direct tiles copied into cropped & incremental sheets"
+tcdir direct_tiles_copied
+# a strict blank limit skips some shots, so the sheet is cropped
+run_mtn -c 4 -r 4 -b 0.2 -o _cropped.jpg
+run_mtn --incremental -s 30 -o _inc.jpg
+run_mtn --incremental -s 30 -o _inc.jpg
+
+colouredecho  "===> Incremental thumbnail run twice"
+tcdir incremental
+run_mtn --incremental -s 30 --vtt
+run_mtn --incremental -s 30 --vtt
+
+colouredecho  "===> Read from standard input"
+tcdir stdin
+if [ -f "$VIDEO" ]; then
+    pushd $O_DIR > /dev/null
+    cat "$VIDEO" | $MTN $MIN_SWITCHES -c 3 -r 2 - &>out.log
+    popd > /dev/null
+fi
+
+colouredecho  "===> Member of an uncompressed archive"
+tcdir archive
+if [ -f "$VIDEO" ]; then
+    pushd $O_DIR > /dev/null
+    tar -cf bundle.tar -C "$(dirname "$VIDEO")" "$(basename "$VIDEO")"
+    $MTN $MIN_SWITCHES -c 3 -r 2 "bundle.tar#$(basename "$VIDEO")" &>out.log
+    $MTN $MIN_SWITCHES -c 3 -r 2 -o _all.jpg bundle.tar &>>out.log
+    rm -f bundle.tar
+    popd > /dev/null
+fi
+
+colouredecho  "===> Http input through the block cache"
+tcdir http_cache
+if [ -f "$VIDEO" ] && which python3 > /dev/null; then
+    pushd $O_DIR > /dev/null
+    # http.server doesn't answer range requests; a small stand-in which does
+    python3 - "$(dirname "$VIDEO")" 8765 <<'PYEOF' &
+import http.server, os, shutil, sys
+class RangeHandler(http.server.SimpleHTTPRequestHandler):
+    def send_head(self):
+        path = self.translate_path(self.path)
+        r = self.headers.get('Range')
+        if not r or not os.path.isfile(path):
+            self.length = None
+            return super().send_head()
+        size = os.path.getsize(path)
+        a, b = r.split('=')[1].split('-')
+        a, b = int(a), min(int(b) if b else size - 1, size - 1)
+        f = open(path, 'rb')
+        f.seek(a)
+        self.length = b - a + 1
+        self.send_response(206)
+        self.send_header('Content-Range', 'bytes %d-%d/%d' % (a, b, size))
+        self.send_header('Content-Length', str(self.length))
+        self.send_header('Accept-Ranges', 'bytes')
+        self.end_headers()
+        return f
+    def copyfile(self, src, dst):
+        if self.length is None:
+            return super().copyfile(src, dst)
+        try:
+            dst.write(src.read(self.length))
+        except ConnectionError:
+            pass
+os.chdir(sys.argv[1])
+http.server.ThreadingHTTPServer(('127.0.0.1', int(sys.argv[2])), RangeHandler).serve_forever()
+PYEOF
+    SERVER=$!
+    sleep 1
+    URL="http://127.0.0.1:8765/$(basename "$VIDEO")"
+    $MTN $MIN_SWITCHES -v --http-cache=cache --http-cache-size=64 -c 3 -r 2 "$URL" &>out.log
+    $MTN $MIN_SWITCHES -v --http-cache=cache --http-cache-size=64 -c 4 -r 4 -o _2.jpg "$URL" &>>out.log
+    kill $SERVER
+    popd > /dev/null
+fi
+
 colouredecho  "===> Paused with normal priority"
 tcdir normal_priority
 run_mtn -c1 -r1 -p -n